@@ -14,6 +14,7 @@ History:
 
 1.0 Created by Henrik Bjorkman 1996-04-06
 1.1 Cleanup by Henrik Bjorkman 1996-04-30
+1.2 Slicing by 8 or 16 bytes per iteration 2026-10-16
 
 
 \*****************************************************************************/
@@ -187,37 +188,350 @@ static uint32_t crc32_reflect32(uint32_t in)
 
 /*****************************************************************************/
 
+/* Number of bytes processed per iteration, 1, 8 or 16. Slicing needs */
+/* CRC32_SLICING tables of 1 KB each, these are made in RAM at first use. */
+#ifndef CRC32_SLICING
+#if (defined OPTIMIZE_FOR_SMALL_CODE_SIZE) || !((defined __linux__) || (defined __WIN32))
+#define CRC32_SLICING 1
+#else
+#define CRC32_SLICING 8
+#endif
+#endif
+
+#if (CRC32_SLICING > 1)
+
+#if (CRC32_SLICING != 8) && (CRC32_SLICING != 16)
+#error CRC32_SLICING must be 1, 8 or 16
+#endif
+
+#ifdef IGNORE_REFLECTION
+/* Most significant bit first, first byte in the stream is the top byte of the 32 bit word. */
+#define CRC32_SLICE_SHIFT(c) ((c)<<8)
+#define CRC32_SLICE_TOP(c) ((c)>>24)
+#define CRC32_SLICE_LOAD32(p) (((uint32_t)(p)[0]<<24)|((uint32_t)(p)[1]<<16)|((uint32_t)(p)[2]<<8)|(uint32_t)(p)[3])
+#define CRC32_SLICE_BYTE(w,k) (((w)>>(24-8*(k)))&0xff)
+#else
+/* Reflected, the running checksum is kept reflected so that no reflection */
+/* is needed per byte or at the end. First byte in the stream is the low byte. */
+#define CRC32_SLICE_SHIFT(c) ((c)>>8)
+#define CRC32_SLICE_TOP(c) ((c)&0xff)
+#define CRC32_SLICE_LOAD32(p) ((uint32_t)(p)[0]|((uint32_t)(p)[1]<<8)|((uint32_t)(p)[2]<<16)|((uint32_t)(p)[3]<<24))
+#define CRC32_SLICE_BYTE(w,k) (((w)>>(8*(k)))&0xff)
+#endif
+
+/* crc32_slice_table[k][i] is the checksum change from byte i followed by k zero bytes. */
+static uint32_t crc32_slice_table[CRC32_SLICING][256];
+static volatile int crc32_slice_table_ready=0;
+
+/* Lookup of the 4 bytes in w using tables t, t-1, t-2 and t-3. */
+#define CRC32_SLICE_WORD(w,t) (crc32_slice_table[t][CRC32_SLICE_BYTE(w,0)]^crc32_slice_table[(t)-1][CRC32_SLICE_BYTE(w,1)]^ \
+    crc32_slice_table[(t)-2][CRC32_SLICE_BYTE(w,2)]^crc32_slice_table[(t)-3][CRC32_SLICE_BYTE(w,3)])
+
+static uint32_t crc32_update_slices(uint32_t crc, const unsigned char *buf, int size)
+{
+  /* Take CRC32_SLICING bytes at a time, one table per byte position. */
+  while(size>=CRC32_SLICING)
+  {
+    const uint32_t w0=crc^CRC32_SLICE_LOAD32(buf);
+    const uint32_t w1=CRC32_SLICE_LOAD32(buf+4);
+    uint32_t c=CRC32_SLICE_WORD(w0,CRC32_SLICING-1)^CRC32_SLICE_WORD(w1,CRC32_SLICING-5);
+#if (CRC32_SLICING == 16)
+    const uint32_t w2=CRC32_SLICE_LOAD32(buf+8);
+    const uint32_t w3=CRC32_SLICE_LOAD32(buf+12);
+    c^=CRC32_SLICE_WORD(w2,7)^CRC32_SLICE_WORD(w3,3);
+#endif
+    crc=c;
+    buf+=CRC32_SLICING;
+    size-=CRC32_SLICING;
+  }
+
+  /* The remaining bytes one at a time. */
+  while(size>0)
+  {
+    crc=CRC32_SLICE_SHIFT(crc)^crc32_slice_table[0][CRC32_SLICE_TOP(crc)^*buf++];
+    size--;
+  }
+  return(crc);
+}
+
+/*****************************************************************************/
+
+/* Folding with carry-less multiplication (PCLMULQDQ), see Intel "Fast CRC */
+/* Computation for Generic Polynomials Using PCLMULQDQ Instruction". */
+/* Only done for the not reflected checksum. It is used if cpuid says */
+/* the CPU has it and it gives same result as the tables on a test buffer. */
+/* Define CRC32_NO_CLMUL to not compile it at all. */
+#if (defined IGNORE_REFLECTION) && (defined __GNUC__) && ((defined __x86_64__) || (defined __i386__)) && !(defined CRC32_NO_CLMUL)
+
+#include <immintrin.h>
+
+/* Shorter buffers are done with the tables. */
+#define CRC32_CLMUL_MIN_SIZE 64
+
+/* x^n mod P for n = 512, 576, 128 and 192, to fold 4 blocks (of 16 bytes) or 1 block forward. */
+static uint64_t crc32_clmul_k[4];
+static int crc32_clmul_ok=0;
+
+/* Byte order reversed so that the first byte is the most significant. */
+#define CRC32_CLMUL_LOAD(p) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(p)),swap)
+
+/* x*k where the high and low 64 bits of x are multiplied with different constants, then d is added. */
+#define CRC32_CLMUL_FOLD(x,k,d) _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x,k,0x00),_mm_clmulepi64_si128(x,k,0x11)),d)
+
+__attribute__((target("pclmul,ssse3")))
+static uint32_t crc32_update_clmul(uint32_t crc, const unsigned char *buf, int size)
+{
+  const __m128i swap=_mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+  const __m128i k512=_mm_set_epi64x((long long)crc32_clmul_k[1],(long long)crc32_clmul_k[0]);
+  const __m128i k128=_mm_set_epi64x((long long)crc32_clmul_k[3],(long long)crc32_clmul_k[2]);
+  unsigned char tmp[16];
+  __m128i x0,x1,x2,x3;
+
+  ASSERT(size>=64);
+
+  /* The running checksum is added to the first 4 bytes. */
+  x0=_mm_xor_si128(CRC32_CLMUL_LOAD(buf),_mm_set_epi32((int)crc,0,0,0));
+  x1=CRC32_CLMUL_LOAD(buf+16);
+  x2=CRC32_CLMUL_LOAD(buf+32);
+  x3=CRC32_CLMUL_LOAD(buf+48);
+  buf+=64;
+  size-=64;
+
+  /* Four independent folds so that the multiplications can overlap. */
+  while(size>=64)
+  {
+    x0=CRC32_CLMUL_FOLD(x0,k512,CRC32_CLMUL_LOAD(buf));
+    x1=CRC32_CLMUL_FOLD(x1,k512,CRC32_CLMUL_LOAD(buf+16));
+    x2=CRC32_CLMUL_FOLD(x2,k512,CRC32_CLMUL_LOAD(buf+32));
+    x3=CRC32_CLMUL_FOLD(x3,k512,CRC32_CLMUL_LOAD(buf+48));
+    buf+=64;
+    size-=64;
+  }
+
+  x0=CRC32_CLMUL_FOLD(x0,k128,x1);
+  x0=CRC32_CLMUL_FOLD(x0,k128,x2);
+  x0=CRC32_CLMUL_FOLD(x0,k128,x3);
+  while(size>=16)
+  {
+    x0=CRC32_CLMUL_FOLD(x0,k128,CRC32_CLMUL_LOAD(buf));
+    buf+=16;
+    size-=16;
+  }
+
+  /* What is left in x0 has the same remainder as all bytes so far, */
+  /* so the tables (starting from zero) give the running checksum. */
+  _mm_storeu_si128((__m128i*)tmp,_mm_shuffle_epi8(x0,swap));
+  crc=crc32_update_slices(0,tmp,sizeof(tmp));
+
+  return(crc32_update_slices(crc,buf,size));
+}
+
+/* x^n mod P */
+static uint32_t crc32_xpow_mod(int n)
+{
+  uint32_t r=1;
+  while(n-->0)
+  {
+    r=(r&0x80000000UL)?((r<<1)^CRC32_POLYNOMIAL):(r<<1);
+  }
+  return(r);
+}
+
+/* Must be called after the tables are made. */
+static void crc32_clmul_select(void)
+{
+  static const int test_sizes[]={64,100,269};
+  unsigned char test[269];
+  unsigned int i;
+
+  crc32_clmul_k[0]=crc32_xpow_mod(512);
+  crc32_clmul_k[1]=crc32_xpow_mod(576);
+  crc32_clmul_k[2]=crc32_xpow_mod(128);
+  crc32_clmul_k[3]=crc32_xpow_mod(192);
+
+  __builtin_cpu_init();
+  if (!__builtin_cpu_supports("pclmul") || !__builtin_cpu_supports("ssse3"))
+  {
+    return;
+  }
+
+  for(i=0;i<sizeof(test);i++)
+  {
+    test[i]=(unsigned char)(i*131+7);
+  }
+  for(i=0;i<sizeof(test_sizes)/sizeof(test_sizes[0]);i++)
+  {
+    if (crc32_update_clmul(CRC32_INITIAL_VALUE,test,test_sizes[i])!=crc32_update_slices(CRC32_INITIAL_VALUE,test,test_sizes[i]))
+    {
+      dbg(printf("crc32_clmul_select: self test failed\n");)
+      return;
+    }
+  }
+  crc32_clmul_ok=1;
+}
 
+#define CRC32_CLMUL
+
+#endif
+
+/*****************************************************************************/
+
+static void crc32_make_slice_table(void)
+{
+  int i,k;
+  for(i=0;i<256;i++)
+  {
+#ifdef IGNORE_REFLECTION
+    crc32_slice_table[0][i]=CRC32_CODE(i);
+#else
+    crc32_slice_table[0][i]=crc32_reflect32(CRC32_CODE(CRC32_REFLECT8BIT(i)));
+#endif
+  }
+  for(k=1;k<CRC32_SLICING;k++)
+  {
+    for(i=0;i<256;i++)
+    {
+      const uint32_t c=crc32_slice_table[k-1][i];
+      crc32_slice_table[k][i]=CRC32_SLICE_SHIFT(c)^crc32_slice_table[0][CRC32_SLICE_TOP(c)];
+    }
+  }
+#ifdef CRC32_CLMUL
+  crc32_clmul_select();
+#endif
+#ifdef __GNUC__
+  __atomic_store_n(&crc32_slice_table_ready, 1, __ATOMIC_RELEASE);
+#else
+  crc32_slice_table_ready=1;
+#endif
+}
+
+static int crc32_slice_table_is_ready(void)
+{
+#ifdef __GNUC__
+  return __atomic_load_n(&crc32_slice_table_ready, __ATOMIC_ACQUIRE);
+#else
+  return crc32_slice_table_ready;
+#endif
+}
+
+#endif
 
 /*****************************************************************************/ 
 
 
-/* calculates a checksumm for a buffer at address "buf" of size "size" */
-uint32_t crc32_calculate(const unsigned char *buf, int size)
+/* updates a running checksumm "crc" with the bytes in buffer at address "buf" of size "size" */
+uint32_t crc32_update(uint32_t crc, const unsigned char *buf, int size)
 {
-  /* this crc starts with all ones. It would be possible to start with something else. */
-  uint32_t crc=0xffffffffl; 
+  ASSERT(buf || (size==0));
 
-  ASSERT(buf);
+#if (CRC32_SLICING > 1)
+  if (!crc32_slice_table_is_ready())
+  {
+    /* Several threads may do this at the same time, they all write the same values. */
+    crc32_make_slice_table();
+  }
 
-  dbg(printf("crc32_calculate: %s %d\n",buf,size);)
+#ifdef CRC32_CLMUL
+  if ((size>=CRC32_CLMUL_MIN_SIZE) && (crc32_clmul_ok))
+  {
+    return(crc32_update_clmul(crc, buf, size));
+  }
+#endif
 
+  crc=crc32_update_slices(crc, buf, size);
+#else
   /* Update the checksum for all bytes in the buffer. */
   int i=0;
   for(i=0;i<size;i++)
   {
-    // TODO We could make a version that does not use reflect since we do not need to use Ethernet compatible CRC.
     crc = CRC32_COMPUTE(crc, CRC32_REFLECT8BIT(*buf++));
   }
+#endif
+
+  return(crc);
+}
 
+/* starts a running checksumm */
+uint32_t crc32_init(void)
+{
+  return(CRC32_INITIAL_VALUE);
+}
+
+/* gives the checksumm from a running checksumm */
+uint32_t crc32_final(uint32_t crc)
+{
+#if (CRC32_SLICING == 1)
   /* reflect the bits in the checksum */
+  /* (with slicing the running checksum is already kept reflected if needed) */
   crc=CRC32_REFLECT32BIT(crc);
+#endif
 
   /* invert the checksum */
   crc=~crc;
 
   return(crc);
+}
+
+/* a*b mod P, polynomials with the most significant bit as highest power */
+static uint32_t crc32_mulmod(uint32_t a, uint32_t b)
+{
+  uint32_t r=0;
+  int i;
+  for(i=31;i>=0;i--)
+  {
+    r=(r&0x80000000UL)?((r<<1)^CRC32_POLYNOMIAL):(r<<1);
+    if (GETBIT(b,i))
+    {
+      r^=a;
+    }
+  }
+  return(r);
+}
+
+/* gives the checksumm of buffer A followed by buffer B from the checksumms of A and B */
+/* The checksumm of A shall be multiplied with x^(8*len2), the initial value and */
+/* final inversion cancel since the initial value is all ones. */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+  /* x^8, then squared for each bit in len2 */
+  uint32_t p=0x100;
+  uint32_t m=1;
+
+#ifndef IGNORE_REFLECTION
+  crc1=crc32_reflect32(crc1);
+  crc2=crc32_reflect32(crc2);
+#endif
+
+  while(len2)
+  {
+    if (len2&1)
+    {
+      m=crc32_mulmod(m,p);
+    }
+    p=crc32_mulmod(p,p);
+    len2>>=1;
+  }
+  crc1=crc32_mulmod(crc1,m)^crc2;
+
+#ifndef IGNORE_REFLECTION
+  crc1=crc32_reflect32(crc1);
+#endif
+  return(crc1);
+}
+
+/* calculates a checksumm for a buffer at address "buf" of size "size" */
+uint32_t crc32_calculate(const unsigned char *buf, int size)
+{
+  /* this crc starts with all ones. It would be possible to start with something else. */
+  uint32_t crc=crc32_init();
+
+  ASSERT(buf);
+
+  dbg(printf("crc32_calculate: %s %d\n",buf,size);)
+
+  crc=crc32_update(crc, buf, size);
 
+  return(crc32_final(crc));
 }
 
 /***************************** end of file ***********************************/
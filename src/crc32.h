@@ -18,4 +18,21 @@ History:
 /* returns a 4 byte checksum for the buffer. */
 uint32_t crc32_calculate(const unsigned char *buf, int size);
 
+/* A running checksum starts with this value. */
+#define CRC32_INITIAL_VALUE 0xffffffffUL
+
+/* Gives the start value of a running checksum, same as CRC32_INITIAL_VALUE. */
+uint32_t crc32_init(void);
+
+/* Updates a running checksum with more bytes. */
+uint32_t crc32_update(uint32_t crc, const unsigned char *buf, int size);
+
+/* Gives the checksum from a running checksum, same as crc32_calculate gives for all the bytes. */
+uint32_t crc32_final(uint32_t crc);
+
+/* Gives the checksum of two adjacent buffers from the checksums (as given by crc32_final) */
+/* of the first and of the second buffer, len2 is the size of the second buffer. */
+/* So a large buffer can be checksummed in parts (perhaps by several threads) and then merged. */
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
 #endif
@@ -0,0 +1,177 @@
+/*****************************************************************************\ 
+crc32c.c
+
+Functions to calculate 32 bit CRC32C (Castagnoli) checksums.
+
+This is the reflected CRC-32C used in iSCSI, SCTP and ext4.
+On x86 CPUs with SSE4.2 the crc32 instruction is used (checked at first use),
+otherwise a table.
+
+History:
+
+1.0 Created 2026-10-16
+
+
+\*****************************************************************************/
+
+/*****************************************************************************/
+
+#include <stdlib.h>
+#include <stdio.h>
+#if (defined __linux__) || (defined __WIN32)
+#include <assert.h>
+#else
+#include "mathi.h"
+#endif
+#include "crc32c.h"
+
+/*****************************************************************************/
+
+
+#ifndef ASSERT
+#define ASSERT assert
+#endif
+
+/* This is the polynomial (reflected) used for calculating the checksum. */
+#define CRC32C_POLYNOMIAL_REFLECTED 0x82F63B78UL
+
+#define CRC32C_INITIAL_VALUE 0xffffffffUL
+
+#if (defined __GNUC__) && ((defined __x86_64__) || (defined __i386__)) && !(defined CRC32C_NO_SSE42)
+#include <immintrin.h>
+#define CRC32C_SSE42
+#endif
+
+/*****************************************************************************/
+
+static uint32_t crc32c_table[256];
+static volatile int crc32c_ready=0;
+#ifdef CRC32C_SSE42
+static int crc32c_sse42_ok=0;
+#endif
+
+static uint32_t crc32c_update_table(uint32_t crc, const unsigned char *buf, int size)
+{
+  while(size>0)
+  {
+    crc=(crc>>8)^crc32c_table[(crc^*buf++)&0xff];
+    size--;
+  }
+  return(crc);
+}
+
+#ifdef CRC32C_SSE42
+
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_sse42(uint32_t crc, const unsigned char *buf, int size)
+{
+#ifdef __x86_64__
+  uint64_t c=crc;
+  while(size>=8)
+  {
+    uint64_t w;
+    __builtin_memcpy(&w,buf,8);
+    c=_mm_crc32_u64(c,w);
+    buf+=8;
+    size-=8;
+  }
+  crc=(uint32_t)c;
+#endif
+  while(size>=4)
+  {
+    uint32_t w;
+    __builtin_memcpy(&w,buf,4);
+    crc=_mm_crc32_u32(crc,w);
+    buf+=4;
+    size-=4;
+  }
+  while(size>0)
+  {
+    crc=_mm_crc32_u8(crc,*buf++);
+    size--;
+  }
+  return(crc);
+}
+
+#endif
+
+static void crc32c_make_table(void)
+{
+  int i,j;
+  for(i=0;i<256;i++)
+  {
+    uint32_t c=i;
+    for(j=0;j<8;j++)
+    {
+      c=(c&1)?((c>>1)^CRC32C_POLYNOMIAL_REFLECTED):(c>>1);
+    }
+    crc32c_table[i]=c;
+  }
+
+#ifdef CRC32C_SSE42
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2"))
+  {
+    /* Check against the table on a test buffer before using it. */
+    unsigned char test[67];
+    for(i=0;i<(int)sizeof(test);i++)
+    {
+      test[i]=(unsigned char)(i*131+7);
+    }
+    crc32c_sse42_ok=(crc32c_update_sse42(CRC32C_INITIAL_VALUE,test,sizeof(test))==crc32c_update_table(CRC32C_INITIAL_VALUE,test,sizeof(test)));
+  }
+#endif
+
+#ifdef __GNUC__
+  __atomic_store_n(&crc32c_ready, 1, __ATOMIC_RELEASE);
+#else
+  crc32c_ready=1;
+#endif
+}
+
+/*****************************************************************************/
+
+uint32_t crc32c_init(void)
+{
+  return(CRC32C_INITIAL_VALUE);
+}
+
+/* updates a running checksumm "crc" with the bytes in buffer at address "buf" of size "size" */
+uint32_t crc32c_update(uint32_t crc, const unsigned char *buf, int size)
+{
+  ASSERT(buf || (size==0));
+
+#ifdef __GNUC__
+  if (!__atomic_load_n(&crc32c_ready, __ATOMIC_ACQUIRE))
+#else
+  if (!crc32c_ready)
+#endif
+  {
+    /* Several threads may do this at the same time, they all write the same values. */
+    crc32c_make_table();
+  }
+
+#ifdef CRC32C_SSE42
+  if (crc32c_sse42_ok)
+  {
+    return(crc32c_update_sse42(crc, buf, size));
+  }
+#endif
+
+  return(crc32c_update_table(crc, buf, size));
+}
+
+/* gives the checksumm from a running checksumm */
+uint32_t crc32c_final(uint32_t crc)
+{
+  return(~crc);
+}
+
+/* calculates a checksumm for a buffer at address "buf" of size "size" */
+uint32_t crc32c_calculate(const unsigned char *buf, int size)
+{
+  ASSERT(buf);
+  return(crc32c_final(crc32c_update(crc32c_init(), buf, size)));
+}
+
+/***************************** end of file ***********************************/
@@ -0,0 +1,30 @@
+/*****************************************************************************\ 
+crc32c.h
+
+Functions to calculate 32 bit CRC32C (Castagnoli) checksums.
+
+
+History:
+
+1.0 Created 2026-10-16
+
+\*****************************************************************************/
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdint.h>
+
+/* returns a 4 byte CRC32C checksum for the buffer. */
+uint32_t crc32c_calculate(const unsigned char *buf, int size);
+
+/* Gives the start value of a running checksum. */
+uint32_t crc32c_init(void);
+
+/* Updates a running checksum with more bytes. */
+uint32_t crc32c_update(uint32_t crc, const unsigned char *buf, int size);
+
+/* Gives the checksum from a running checksum, same as crc32c_calculate gives for all the bytes. */
+uint32_t crc32c_final(uint32_t crc);
+
+#endif
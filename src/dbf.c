@@ -19,12 +19,15 @@
 #include <inttypes.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include "sys_time.h"
 #endif
 
 
 #include "crc32.h"
+#include "crc32c.h"
 #include "dbf.h"
+#include "dbf_buffer_pool.h"
 
 #ifdef DBF_AND_ASCII
 #include "utility_functions.h"
@@ -37,10 +40,44 @@
 #ifndef DBF_FIXED_MSG_SIZE
 #define INITIAL_BUFFER_SIZE 256
 #endif
+
+// Codes are only written if there is room for at least 12 more bytes in the buffer
+// (see DbfSerializerEncodeData64_step2) so when reserving room that is needed in addition.
+#define DBF_RESERVE_MARGIN 16
+
+// A CRC is 32 bits, that is at most 5 bytes with a FMTCRC code (4 + 4*7 bits).
+#define DBF_MAX_CRC_BYTES 5
+
+// With running CRC the written bytes are added to the CRC when there are this many.
+#define DBF_RUNNING_CRC_CHUNK 64
+
+// Buffers given by caller (see DbfSerializerInitBuffer) were not allocated by ST_MALLOC so those can not be checked.
+#define DBF_SERIALIZER_ASSERT_BUFFER(s) {if (!(s)->external_buffer) {ST_ASSERT_SIZE((s)->buffer, (s)->capacity);}}
 #define ASCII_OFFSET 64
 
 #define IGNORE_UNTIL_SILENCE_MS 100
 
+// Encode each code with one unaligned 8 byte store instead of one byte at a time.
+// Define DBF_BYTEWISE_ENCODER to get the original byte by byte encoder (to compare or benchmark).
+#if (!defined DBF_FIXED_MSG_SIZE) && (!defined DBF_BYTEWISE_ENCODER) && (defined __GNUC__) && (BITNESS == 64) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define DBF_WIDE_STORE_ENCODER
+#endif
+
+// Decode each code with one unaligned 8 byte load in a single forward pass instead of
+// finding the end of the code and then decoding it backwards.
+// Define DBF_BYTEWISE_DECODER to get the byte by byte forward decoder.
+#if (!defined DBF_BYTEWISE_DECODER) && (defined __GNUC__) && (BITNESS == 64) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define DBF_WIDE_LOAD_DECODER
+#endif
+
+#if ((defined DBF_WIDE_STORE_ENCODER) || (defined DBF_WIDE_LOAD_DECODER)) && (defined __BMI2__)
+#include <immintrin.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 /*
 DebugableBinaryFormat (DBF) AKA DrekkarBinaryFormat
 
@@ -278,10 +315,60 @@ static void DbfSerializerInitBase(DbfSerializer *s)
 	#if (!defined DBF_FIXED_MSG_SIZE)
 	s->capacity = INITIAL_BUFFER_SIZE;
 	s->buffer = ST_MALLOC(s->capacity);
+	s->external_buffer = 0;
+	s->resize = NULL;
 	debug_counter++;
 	#endif
+	s->running_crc = crc32_init();
+	s->crc_pos = 0;
+	s->running_crc_enabled = 0;
 };
 
+// Same as DbfSerializerInit but the buffer is allocated big enough for a message
+// of nbytes bytes (see DbfSizerGetMsgLen) so that it never needs to be resized.
+// Remember that DbfSerializerDeinit must be called when the serializer is no longer
+// needed otherwise there will be a memory leak.
+void DbfSerializerInitReserve(DbfSerializer *s, unsigned long nbytes)
+{
+	s->pos = 0;
+	s->repeat_counter = 0;
+	s->prev_code = 0;
+	#if (!defined DBF_FIXED_MSG_SIZE)
+	s->capacity = nbytes + DBF_RESERVE_MARGIN;
+	s->buffer = ST_MALLOC(s->capacity);
+	s->external_buffer = 0;
+	s->resize = NULL;
+	debug_counter++;
+	#endif
+	s->running_crc = crc32_init();
+	s->crc_pos = 0;
+	s->running_crc_enabled = 0;
+	s->encoderState = DBF_ENCODER_IDLE;
+}
+
+#if (!defined DBF_FIXED_MSG_SIZE)
+// Serialize into a buffer given by caller (on stack or in an arena), nothing is allocated.
+// If the message does not fit the buffer is not resized, instead encoderState is set to
+// DBF_ENCODER_ERROR (same as when DBF_FIXED_MSG_SIZE is used), see DbfSerializerIsOverflow.
+// Only binary encoding can be used with such a buffer.
+// DbfSerializerDeinit shall still be called but the buffer is not freed, that is up to the caller.
+void DbfSerializerInitBuffer(DbfSerializer *s, unsigned char *buffer, unsigned int size)
+{
+	assert(s && buffer);
+	s->pos = 0;
+	s->repeat_counter = 0;
+	s->prev_code = 0;
+	s->capacity = size;
+	s->buffer = buffer;
+	s->external_buffer = 1;
+	s->resize = NULL;
+	s->running_crc = crc32_init();
+	s->crc_pos = 0;
+	s->running_crc_enabled = 0;
+	s->encoderState = DBF_ENCODER_IDLE;
+}
+#endif
+
 // Remember that DbfSerializerDeinit must be called when the serializer is no longer
 // needed otherwise there will be a memory leak.
 void DbfSerializerInit(DbfSerializer *s)
@@ -309,7 +396,7 @@ void DbfSerializerSetAsciiSeparator(DbfSerializer *s, int64_t ch)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 
 	// prev_code is not used in ascii mode so will use it as separator character instead.
@@ -327,10 +414,18 @@ void DbfSerializerDeinit(DbfSerializer *s)
 	s->repeat_counter = 0;
 	s->prev_code = 0;
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_FREE_SIZE(s->buffer, s->capacity);
+	if (s->external_buffer)
+	{
+		// The buffer belongs to caller.
+		s->external_buffer = 0;
+	}
+	else
+	{
+		ST_FREE_SIZE(s->buffer, s->capacity);
+		debug_counter--;
+	}
 	s->buffer = NULL;
 	s->capacity = 0;
-	debug_counter--;
 	#endif
 };
 
@@ -339,7 +434,7 @@ void DbfSerializerReset(DbfSerializer *s)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 	s->pos = 0;
 	if (s->encoderState != DBF_ENCODER_ASCII_MODE)
@@ -348,17 +443,76 @@ void DbfSerializerReset(DbfSerializer *s)
 		s->prev_code = 0;
 	}
 	s->repeat_counter = 0;
+	s->running_crc = crc32_init();
+	s->crc_pos = 0;
+}
+
+// Opt in to have the CRC calculated a chunk at a time while the message is written,
+// while the bytes are still in cache. Then DbfSerializerWriteCrc only needs to do the
+// last few bytes instead of a second pass over the entire message.
+// Stays enabled also after DbfSerializerReset. Only for binary encoding.
+void DbfSerializerEnableRunningCrc(DbfSerializer *s)
+{
+	assert(s);
+	s->running_crc_enabled = 1;
+	s->running_crc = crc32_init();
+	s->crc_pos = 0;
+}
+
+// If running CRC is enabled, include written bytes in it when there are at least min_bytes of them.
+static void DbfSerializerUpdateRunningCrc(DbfSerializer *s, unsigned int min_bytes)
+{
+	if ((s->running_crc_enabled) && ((s->pos - s->crc_pos) >= min_bytes))
+	{
+		s->running_crc = crc32_update(s->running_crc, s->buffer + s->crc_pos, s->pos - s->crc_pos);
+		s->crc_pos = s->pos;
+	}
 }
 
+#if (!defined DBF_FIXED_MSG_SIZE)
+static void DbfSerializerSetCapacity(DbfSerializer *s, unsigned int new_capacity)
+{
+	if (s->resize != NULL)
+	{
+		s->buffer = s->resize(s, new_capacity);
+	}
+	else
+	{
+		s->buffer = ST_RESIZE(s->buffer, s->capacity, new_capacity);
+	}
+	s->capacity = new_capacity;
+}
+#endif
+
 static void DbfSerializerResizeIfNeeded(DbfSerializer* s, long needed_capacity)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
-	if (needed_capacity >= s->capacity)
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
+	if ((needed_capacity >= s->capacity) && (!s->external_buffer))
+	{
+		// Double the size until it is enough, then resize (copy) only once.
+		unsigned int new_capacity = s->capacity*2;
+		while (needed_capacity >= new_capacity)
+		{
+			new_capacity *= 2;
+		}
+		DbfSerializerSetCapacity(s, new_capacity);
+	}
+	#endif
+}
+
+// Make sure that nbytes more bytes can be written without the buffer being resized.
+// Resizes at most once. Use DbfSizer to know how many bytes a message will need.
+void DbfSerializerReserve(DbfSerializer *s, unsigned long nbytes)
+{
+	assert(s);
+	#if (!defined DBF_FIXED_MSG_SIZE)
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
+	const unsigned long needed_capacity = s->pos + nbytes + DBF_RESERVE_MARGIN;
+	if ((needed_capacity > s->capacity) && (!s->external_buffer))
 	{
-		s->buffer = ST_RESIZE(s->buffer, s->capacity, s->capacity*2);
-		s->capacity *= 2;
+		DbfSerializerSetCapacity(s, needed_capacity);
 	}
 	#endif
 }
@@ -368,11 +522,27 @@ static void DbfSerializerPutByte(DbfSerializer *s, char b)
 	assert(s);
 
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 
 	// If the below is commented out, make sure the buffer is big enough before calling this.
 	//DbfSerializerResize(s, dbfSerializer->pos);
 
+	if (s->external_buffer)
+	{
+		// Caller given buffers are not resized, same as with DBF_FIXED_MSG_SIZE.
+		if (s->pos<s->capacity)
+		{
+			s->buffer[s->pos] = b;
+			s->pos++;
+		}
+		else
+		{
+			debug_log("DbfSerializerPutByte full");
+			s->encoderState = DBF_ENCODER_ERROR;
+		}
+		return;
+	}
+
 	s->buffer[s->pos] = b;
 	s->pos++;
 
@@ -394,18 +564,126 @@ static void DbfSerializerPutByte(DbfSerializer *s, char b)
 	#endif
 }
 
+// Gives the number of bytes (sub codes) needed to encode data
+// when nofb bits fit in the start sub code. nofb may not be more than 6.
+static unsigned int DbfSerializerEncodedLength64(unsigned int nofb, uint64_t data)
+{
+	// Number of significant bits in data.
+	#ifdef __GNUC__
+	const unsigned int nb = (data != 0) ? (64 - __builtin_clzll(data)) : 0;
+	#else
+	unsigned int nb = 0;
+	while (data != 0)
+	{
+		data = data >> 1;
+		nb++;
+	}
+	#endif
+
+	// One start sub code plus one extension sub code per started 7 bits that did not fit.
+	return 1 + (nb + (DBF_EXT_DATANBITS - 1) - nofb) / DBF_EXT_DATANBITS;
+}
+
+#ifdef DBF_WIDE_STORE_ENCODER
+
+// Moves 7 bits at a time from x into the 8 bytes of the result.
+// Bits above the 56 least significant are lost.
+static uint64_t DbfSerializerSpread7(uint64_t x)
+{
+	#ifdef __BMI2__
+	return _pdep_u64(x, 0x7f7f7f7f7f7f7f7fULL);
+	#else
+	return (x & 0x7fULL) |
+		((x << 1) & 0x7f00ULL) |
+		((x << 2) & 0x7f0000ULL) |
+		((x << 3) & 0x7f000000ULL) |
+		((x << 4) & 0x7f00000000ULL) |
+		((x << 5) & 0x7f0000000000ULL) |
+		((x << 6) & 0x7f000000000000ULL) |
+		((x << 7) & 0x7f00000000000000ULL);
+	#endif
+}
+
+/**
+ * Same as the byte by byte encoder below but the length is calculated first
+ * and then the start sub code and up to 7 extension sub codes are written
+ * with one 8 byte store. Only codes longer than 8 bytes need more.
+ * There must be room for at least 12 bytes after pos.
+ */
+static void DbfSerializerStoreCode64(DbfSerializer *s, unsigned int code, unsigned int nofb, uint64_t data)
+{
+	const unsigned int m = (1<<nofb)-1; // mask for data to be written together with format code.
+	const unsigned int len = DbfSerializerEncodedLength64(nofb, data);
+
+	if (s->pos + 12 > s->capacity)
+	{
+		// Only happens with a caller given buffer (those are not resized) when it is almost full.
+		// Check that the code fits and write it a byte at a time.
+		assert(s->external_buffer);
+		if ((s->encoderState == DBF_ENCODER_ERROR) || (s->pos + len > s->capacity))
+		{
+			debug_log("DbfSerializerStoreCode64 full");
+			s->encoderState = DBF_ENCODER_ERROR;
+			return;
+		}
+		s->buffer[s->pos++] = code + (data & m);
+		data = data >> nofb;
+		for(unsigned int i = 1; i < len; ++i)
+		{
+			s->buffer[s->pos++] = DBF_EXT_CODEID + (data & DBF_EXT_DATAMASK);
+			data = data >> DBF_EXT_DATANBITS;
+		}
+		return;
+	}
+
+	// Bytes not part of this code must be zero, both in the data and in the extension code flags.
+	const unsigned int k = (len < 8) ? len : 8;
+	const uint64_t keep = ~0ULL >> (64 - 8 * k);
+
+	const uint64_t w = (code + (data & m)) |
+		(DbfSerializerSpread7(data >> nofb) << 8) |
+		(0x8080808080808000ULL & keep);
+
+	unsigned char *p = s->buffer + s->pos;
+	memcpy(p, &w, sizeof(w));
+
+	// Very large numbers need more than 7 extension sub codes.
+	uint64_t rest = data >> (nofb + 7 * DBF_EXT_DATANBITS);
+	for(unsigned int i = 8; i < len; ++i)
+	{
+		p[i] = DBF_EXT_CODEID + (rest & DBF_EXT_DATAMASK);
+		rest = rest >> DBF_EXT_DATANBITS;
+	}
+
+	s->pos += len;
+	assert(s->pos <= s->capacity);
+}
+
+static void DbfSerializerEncodeData64_step2(DbfSerializer *s, unsigned int code, unsigned int nofb, uint64_t data)
+{
+	// Make sure there is room in the buffer (also for the wide store). Make it bigger if needed.
+	DbfSerializerResizeIfNeeded(s, s->pos + 12);
+	DbfSerializerStoreCode64(s, code, nofb, data);
+	DbfSerializerUpdateRunningCrc(s, DBF_RUNNING_CRC_CHUNK);
+}
+
+static void DbfSerializerEncodeData32_step2(DbfSerializer *s, unsigned int code, unsigned int nofb, uint32_t data)
+{
+	DbfSerializerEncodeData64_step2(s, code, nofb, data);
+}
+
+#else
+
 /**
  * Parameters:
  * dbfSerializer: pointer to the struct that the data is written to.
  * code: Tells the type of data to be written.
  * nofb: The number of data bits that will fit in one byte together with c.
  * data: The actual data
+ * There must be room for at least 12 bytes after pos.
  */
-static void DbfSerializerEncodeData64_step2(DbfSerializer *s, unsigned int code, unsigned int nofb, uint64_t data)
+static void DbfSerializerStoreCode64(DbfSerializer *s, unsigned int code, unsigned int nofb, uint64_t data)
 {
-	// Make sure there is room in the buffer. Make it bigger if needed.
-	DbfSerializerResizeIfNeeded(s, s->pos + 12);
-
 	const unsigned int m = (1<<nofb)-1; // mask for data to be written together with format code.
 
 	// Send the type of code part and as many bits as will fit in first byte.
@@ -420,6 +698,14 @@ static void DbfSerializerEncodeData64_step2(DbfSerializer *s, unsigned int code,
 	}
 }
 
+static void DbfSerializerEncodeData64_step2(DbfSerializer *s, unsigned int code, unsigned int nofb, uint64_t data)
+{
+	// Make sure there is room in the buffer. Make it bigger if needed.
+	DbfSerializerResizeIfNeeded(s, s->pos + 12);
+	DbfSerializerStoreCode64(s, code, nofb, data);
+	DbfSerializerUpdateRunningCrc(s, DBF_RUNNING_CRC_CHUNK);
+}
+
 static void DbfSerializerEncodeData32_step2(DbfSerializer *s, unsigned int code, unsigned int nofb, uint32_t data)
 {
 	// Make sure there is room in the buffer. Make it bigger if needed.
@@ -437,8 +723,11 @@ static void DbfSerializerEncodeData32_step2(DbfSerializer *s, unsigned int code,
 		DbfSerializerPutByte(s, DBF_EXT_CODEID + (data & DBF_EXT_DATAMASK));
 		data = data >> DBF_EXT_DATANBITS;
 	}
+	DbfSerializerUpdateRunningCrc(s, DBF_RUNNING_CRC_CHUNK);
 }
 
+#endif
+
 static void DbfSerializerWriteRepeat(DbfSerializer *s)
 {
 	if (s->repeat_counter > 0)
@@ -461,15 +750,50 @@ static void DbfSerializerEncodeData32(DbfSerializer *s, unsigned int code, unsig
 	DbfSerializerEncodeData32_step2(s, code, nofb, data);
 }
 
+// Writes a format code and changes encoder state, unless the buffer got full
+// (then it stays DBF_ENCODER_ERROR so that nothing more is written).
+static void DbfSerializerWriteFormat(DbfSerializer *s, unsigned int code, encoder_states_type state)
+{
+	DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, code);
+	if (s->encoderState != DBF_ENCODER_ERROR)
+	{
+		s->encoderState = state;
+	}
+}
+
 void DbfSerializerWriteCrc(DbfSerializer *s)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
+	#endif
+
+	DbfSerializerWriteRepeat(s);
+	uint32_t crc;
+	if (s->running_crc_enabled)
+	{
+		// Only the bytes not yet included need to be done.
+		DbfSerializerUpdateRunningCrc(s, 0);
+		crc = crc32_final(s->running_crc);
+	}
+	else
+	{
+		crc = crc32_calculate((const unsigned char *)s->buffer, s->pos);
+	}
+	DbfSerializerEncodeData32_step2(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, crc);
+}
+
+void DbfSerializerWriteCrc32c(DbfSerializer *s)
+{
+	assert(s);
+	#if (!defined DBF_FIXED_MSG_SIZE)
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 
 	DbfSerializerWriteRepeat(s);
-	const uint32_t crc = crc32_calculate((const unsigned char *)s->buffer, s->pos);
+	// A format code tells which CRC it is, it is included in the CRC.
+	DbfSerializerEncodeData32_step2(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_CRC32C_CODE);
+	const uint32_t crc = crc32c_final(crc32c_update(crc32c_init(), (const unsigned char *)s->buffer, s->pos));
 	DbfSerializerEncodeData32_step2(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, crc);
 }
 
@@ -521,7 +845,7 @@ void DbfSerializerWriteInt32(DbfSerializer *s, int32_t i)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 
 	#ifdef DBF_OPTIMIZE_FOR_32_BITS
@@ -541,8 +865,7 @@ void DbfSerializerWriteInt32(DbfSerializer *s, int32_t i)
 		default:
 			// Previous code was not an integer so we must first send the format code.
 			// Using the FMTCRC code to send the format.
-			DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_INT_BEGIN_CODE);
-			s->encoderState = DBF_ENCODING_INT;
+			DbfSerializerWriteFormat(s, DBF_INT_BEGIN_CODE, DBF_ENCODING_INT);
 			break;
 	}
 	DbfSerializerWriteCode32(s, i);
@@ -586,13 +909,117 @@ void DbfSerializerWriteInt64(DbfSerializer *s, int64_t i)
 		default:
 			// Previous code was not an integer so we must first send the format code.
 			// Using the FMTCRC code to send the format.
-			DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_INT_BEGIN_CODE);
-			s->encoderState = DBF_ENCODING_INT;
+			DbfSerializerWriteFormat(s, DBF_INT_BEGIN_CODE, DBF_ENCODING_INT);
 			break;
 	}
 	DbfSerializerWriteCode64(s, i);
 }
 
+// Worst case number of bytes written per value by DbfSerializerWriteInt64Array,
+// a 64 bit number code and a repeat code. See also DbfSerializerEncodedLength64.
+#define DBF_MAX_BYTES_PER_VALUE 20
+
+// Number of values to make room for at a time.
+#define DBF_ARRAY_CHUNK_SIZE 64
+
+// Same as calling DbfSerializerWriteInt64 for each value in the array
+// (the resulting message is identical) but the format code state and the
+// buffer size are checked once per chunk of values, not once per value
+// (unless the buffer is nearly full).
+void DbfSerializerWriteInt64Array(DbfSerializer *s, const int64_t *a, size_t n)
+{
+	assert(s && ((a != NULL) || (n == 0)));
+	#if (!defined DBF_FIXED_MSG_SIZE)
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
+	#endif
+
+	if (n == 0)
+	{
+		return;
+	}
+
+	switch(s->encoderState)
+	{
+		case DBF_ENCODING_INT:
+			break;
+		case DBF_ENCODER_IDLE:
+			s->encoderState = DBF_ENCODING_INT;
+			break;
+		case DBF_ENCODER_ERROR:
+			return;
+		#ifdef DBF_AND_ASCII
+		case DBF_ENCODER_ASCII_MODE:
+			// Nothing to gain in ascii mode, write the values one at a time.
+			for(size_t k = 0; k < n; ++k)
+			{
+				DbfSerializerWriteInt64(s, a[k]);
+			}
+			return;
+		#endif
+		default:
+			DbfSerializerWriteFormat(s, DBF_INT_BEGIN_CODE, DBF_ENCODING_INT);
+			break;
+	}
+
+	size_t k = 0;
+	while (k < n)
+	{
+		const size_t end = ((n - k) > DBF_ARRAY_CHUNK_SIZE) ? (k + DBF_ARRAY_CHUNK_SIZE) : n;
+
+		// The buffer may be full if it can not be resized.
+		if (s->encoderState == DBF_ENCODER_ERROR)
+		{
+			return;
+		}
+
+		// If there is room for the worst case of the entire chunk no more checks are needed.
+		// Otherwise room is made for each code as it is written, so that the buffer is not
+		// made bigger than the codes actually need (a size given by DbfSizer is enough).
+		#if (!defined DBF_FIXED_MSG_SIZE)
+		const int room = (s->pos + 12 + (end - k) * DBF_MAX_BYTES_PER_VALUE) < s->capacity;
+		#else
+		const int room = 1; // Not resized, each byte is checked when written.
+		#endif
+
+		// Same logic as in DbfSerializerWriteCode64.
+		for(; k < end; ++k)
+		{
+			const int64_t i = a[k];
+			if (i == s->prev_code)
+			{
+				s->repeat_counter++;
+			}
+			else
+			{
+				if (s->repeat_counter > 0)
+				{
+					if (!room)
+					{
+						DbfSerializerResizeIfNeeded(s, s->pos + 12);
+					}
+					DbfSerializerStoreCode64(s, DBF_REPEAT_CODEID, DBF_REPEAT_DATANBITS, s->repeat_counter);
+					s->repeat_counter = 0;
+				}
+				if (!room)
+				{
+					DbfSerializerResizeIfNeeded(s, s->pos + 12);
+				}
+				if (i>=0)
+				{
+					DbfSerializerStoreCode64(s, DBF_PINT_CODEID, DBF_PINT_DATANBITS, i);
+				}
+				else
+				{
+					DbfSerializerStoreCode64(s, DBF_NINT_CODEID, DBF_NINT_DATANBITS, -1LL-i);
+				}
+				s->prev_code = i;
+			}
+		}
+
+		DbfSerializerUpdateRunningCrc(s, DBF_RUNNING_CRC_CHUNK);
+	}
+}
+
 
 static void DbfSerializerBeginWriteNumber(DbfSerializer *s)
 {
@@ -621,8 +1048,7 @@ static void DbfSerializerBeginWriteNumber(DbfSerializer *s)
 
 			// Write a string format code to tell receiver that it is a string that follows.
 			// It is needed also if previous parameter was a string since this also separates strings.
-			DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_INT_BEGIN_CODE);
-			s->encoderState = DBF_ENCODING_STR;
+			DbfSerializerWriteFormat(s, DBF_INT_BEGIN_CODE, DBF_ENCODING_STR);
 			break;
 	}
 }
@@ -654,8 +1080,7 @@ static void DbfSerializerBeginWriteWord(DbfSerializer *s)
 
 			// Write a string format code to tell receiver that it is a string that follows.
 			// It is needed also if previous parameter was a string since this also separates strings.
-			DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_WORD_BEGIN_CODE);
-			s->encoderState = DBF_ENCODING_STR;
+			DbfSerializerWriteFormat(s, DBF_WORD_BEGIN_CODE, DBF_ENCODING_STR);
 			break;
 	}
 }
@@ -695,8 +1120,7 @@ static void DbfSerializerBeginWriteString(DbfSerializer *s)
 
 			// Write a string format code to tell receiver that it is a string that follows.
 			// It is needed also if previous parameter was a string since this also separates strings.
-			DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, DBF_STR_BEGIN_CODE);
-			s->encoderState = DBF_ENCODING_STR;
+			DbfSerializerWriteFormat(s, DBF_STR_BEGIN_CODE, DBF_ENCODING_STR);
 			break;
 	}
 }
@@ -706,6 +1130,8 @@ static void DbfSerializerEndWrite(DbfSerializer *s)
 	switch(s->encoderState)
 	{
 		case DBF_ENCODER_ERROR:
+			// Repeats counted after the buffer got full are never written.
+			s->repeat_counter = 0;
 			return;
 		#ifdef DBF_AND_ASCII
 		case DBF_ENCODER_ASCII_MODE:
@@ -732,6 +1158,75 @@ static void DbfSerializerEndWrite(DbfSerializer *s)
 	assert(s->pos <= s->capacity);
 }
 
+static unsigned int DbfLowestSetBit(uint64_t w)
+{
+	#ifdef __GNUC__
+	return __builtin_ctzll(w);
+	#else
+	unsigned int n = 0;
+	while ((w & 1) == 0)
+	{
+		w >>= 1;
+		n++;
+	}
+	return n;
+	#endif
+}
+
+// Writes the characters up to the terminating zero, one code per character
+// (or repeat codes), same as DbfSerializerWriteCode32(s, ch - ASCII_OFFSET) for each.
+static void DbfSerializerWriteChars(DbfSerializer *s, const char *str)
+{
+	#if (defined __SSE2__) && (!defined DBF_FIXED_MSG_SIZE)
+	const char *end = str + strlen(str);
+	while (str < end)
+	{
+		// Blocks of characters in range ' ' to DEL where no character is same as the one before
+		// are one byte codes each, those can be translated and written 16 at a time.
+		if ((s->repeat_counter == 0) && (end - str >= 16))
+		{
+			// The buffer is not made bigger for this, near its end the characters are
+			// written one at a time so that a size given by DbfSizer is enough.
+			if (s->pos + 16 <= s->capacity)
+			{
+				const __m128i v = _mm_loadu_si128((const __m128i*)str);
+				// Signed compare so characters from 128 and up are not in range.
+				const unsigned int inRange = _mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8(' ' - 1)));
+				const unsigned int sameAsPrev = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_slli_si128(v, 1))) & 0xfffe;
+				const unsigned int stop = (~inRange & 0xffff) | sameAsPrev | 0x10000;
+				unsigned int k = DbfLowestSetBit(stop);
+				if ((k > 0) && ((str[0] - ASCII_OFFSET) == s->prev_code))
+				{
+					k = 0;
+				}
+				if (k > 0)
+				{
+					// From ASCII_OFFSET a Pnc code is the character itself, below it is an Nnc code.
+					const __m128i pnc = _mm_cmpgt_epi8(v, _mm_set1_epi8(ASCII_OFFSET - 1));
+					const __m128i nnc = _mm_sub_epi8(_mm_set1_epi8(ASCII_OFFSET - 1 + DBF_NINT_CODEID), v);
+					_mm_storeu_si128((__m128i*)(s->buffer + s->pos), _mm_or_si128(_mm_and_si128(pnc, v), _mm_andnot_si128(pnc, nnc)));
+					s->pos += k;
+					s->prev_code = str[k - 1] - ASCII_OFFSET;
+					str += k;
+					DbfSerializerUpdateRunningCrc(s, DBF_RUNNING_CRC_CHUNK);
+					continue;
+				}
+			}
+		}
+		int i = *str;
+		DbfSerializerWriteCode32(s, i-ASCII_OFFSET);
+		str++;
+	}
+	#else
+	while(*str)
+	{
+		int i = *str;
+		DbfSerializerWriteCode32(s, i-ASCII_OFFSET);
+		str++;
+	}
+	#endif
+}
+
 // This writes 7 bit ascii strings.
 // TODO A function to encode Unicode strings.
 static void serializerWrite(DbfSerializer *s, const char *str, size_t len, long code)
@@ -748,8 +1243,7 @@ static void serializerWrite(DbfSerializer *s, const char *str, size_t len, long
 			while ((s->pos + len + 8) > s->capacity)
 			{
 				// Get a bigger buffer.
-				s->buffer = ST_RESIZE(s->buffer, s->capacity, s->capacity*2);
-				s->capacity *= 2;
+				DbfSerializerSetCapacity(s, s->capacity*2);
 			}
 
 			// Add word separator character (typically space or slash) if needed.
@@ -818,14 +1312,11 @@ static void serializerWrite(DbfSerializer *s, const char *str, size_t len, long
 			// Send a string format code to tell receiver that it is a string that follows.
 			// It is needed also if previous parameter was a string since this also separates strings.
 			// Using DBF_CRC shall be used for format code.
-			DbfSerializerEncodeData32(s, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, code);
-			s->encoderState = DBF_ENCODING_WORD;
+			DbfSerializerWriteFormat(s, code, DBF_ENCODING_WORD);
 
-			while(*str)
+			if (s->encoderState != DBF_ENCODER_ERROR)
 			{
-				int i = *str;
-				DbfSerializerWriteCode32(s, i-ASCII_OFFSET);
-				str++;
+				DbfSerializerWriteChars(s, str);
 			}
 			break;
 	}
@@ -838,7 +1329,7 @@ void DbfSerializerWriteWord(DbfSerializer *s, const char *str)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 
 	// For now only characters larger than ' ' and not over '~' are written.
@@ -861,7 +1352,7 @@ void DbfSerializerWriteString(DbfSerializer *s, const char *str)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 
 	// For now only characters larger than ' ' and not over '~' are written.
@@ -875,7 +1366,7 @@ void DbfSerializerFinalize(DbfSerializer *s)
 {
 	assert(s);
 	#if (!defined DBF_FIXED_MSG_SIZE)
-	ST_ASSERT_SIZE(s->buffer, s->capacity);
+	DBF_SERIALIZER_ASSERT_BUFFER(s);
 	#endif
 
 	DbfSerializerEndWrite(s);
@@ -895,21 +1386,172 @@ unsigned int DbfSerializerGetMsgLen(const DbfSerializer *s)
 	return s->pos;
 }
 
+// Returns non zero if the message did not fit in the buffer.
+// Can only happen with DBF_FIXED_MSG_SIZE or DbfSerializerInitBuffer.
+int DbfSerializerIsOverflow(const DbfSerializer *s)
+{
+	assert(s);
+	return (s->encoderState == DBF_ENCODER_ERROR);
+}
 
 
-#if defined __linux__ || defined __WIN32 || __arm__
-//#if 1
-// Table for faster decoding of first byte in a code.
-/*DbfCodeTypesEnum*/ uint8_t codeTypeTable[256] = {
-		DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,
-		DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,
-		DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,
-		DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,
-		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
-		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
-		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
-		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
-		DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,
+/*
+A DbfSizer is used to know how many bytes a message will need before it is written.
+Do the same sequence of DbfSizerWrite... calls as will be done with the DbfSerializer
+and then DbfSizerGetMsgLen gives the size of the (binary) message.
+It follows the same rules as the serializer for format codes and repeat codes so
+the size is exact. Except for the CRC that is counted as its maximum size since its
+value is not known until the message is written, so the message may be up to
+4 bytes shorter than given if there is a CRC.
+*/
+
+void DbfSizerInit(DbfSizer *z)
+{
+	assert(z);
+	z->size = 0;
+	z->encoderState = DBF_ENCODER_IDLE;
+	z->prev_code = 0;
+	z->repeat_counter = 0;
+}
+
+// Same as DbfSerializerWriteRepeat.
+static void DbfSizerWriteRepeat(DbfSizer *z)
+{
+	if (z->repeat_counter > 0)
+	{
+		z->size += DbfSerializerEncodedLength64(DBF_REPEAT_DATANBITS, z->repeat_counter);
+		z->repeat_counter = 0;
+		z->prev_code = 0;
+	}
+}
+
+// Same as DbfSerializerEncodeData32 with a FMTCRC code.
+static void DbfSizerWriteFormat(DbfSizer *z, unsigned int code)
+{
+	DbfSizerWriteRepeat(z);
+	z->size += DbfSerializerEncodedLength64(DBF_FMTCRC_DATANBITS, code);
+}
+
+// Same as DbfSerializerWriteCode64.
+static void DbfSizerWriteCode64(DbfSizer *z, int64_t i)
+{
+	if (i == z->prev_code)
+	{
+		z->repeat_counter++;
+	}
+	else
+	{
+		DbfSizerWriteRepeat(z);
+		if (i>=0)
+		{
+			z->size += DbfSerializerEncodedLength64(DBF_PINT_DATANBITS, i);
+		}
+		else
+		{
+			z->size += DbfSerializerEncodedLength64(DBF_NINT_DATANBITS, -1LL-i);
+		}
+		z->prev_code = i;
+	}
+}
+
+void DbfSizerWriteInt64(DbfSizer *z, int64_t i)
+{
+	assert(z);
+	switch(z->encoderState)
+	{
+		case DBF_ENCODING_INT:
+			break;
+		case DBF_ENCODER_IDLE:
+			z->encoderState = DBF_ENCODING_INT;
+			break;
+		default:
+			DbfSizerWriteFormat(z, DBF_INT_BEGIN_CODE);
+			z->encoderState = DBF_ENCODING_INT;
+			break;
+	}
+	DbfSizerWriteCode64(z, i);
+}
+
+void DbfSizerWriteInt32(DbfSizer *z, int32_t i)
+{
+	DbfSizerWriteInt64(z, i);
+}
+
+void DbfSizerWriteInt64Array(DbfSizer *z, const int64_t *a, size_t n)
+{
+	assert(z && ((a != NULL) || (n == 0)));
+	for(size_t k = 0; k < n; ++k)
+	{
+		DbfSizerWriteInt64(z, a[k]);
+	}
+}
+
+// Same as serializerWrite (in binary mode).
+static void DbfSizerWriteChars(DbfSizer *z, const char *str, long code)
+{
+	DbfSizerWriteFormat(z, code);
+	z->encoderState = DBF_ENCODING_WORD;
+	while(*str)
+	{
+		int i = *str;
+		DbfSizerWriteCode64(z, i-ASCII_OFFSET);
+		str++;
+	}
+}
+
+void DbfSizerWriteWord(DbfSizer *z, const char *str)
+{
+	assert(z && str);
+	DbfSizerWriteChars(z, str, (word_length(str) == 0) ? DBF_STR_BEGIN_CODE : DBF_WORD_BEGIN_CODE);
+}
+
+void DbfSizerWriteString(DbfSizer *z, const char *str)
+{
+	assert(z && str);
+	DbfSizerWriteChars(z, str, DBF_STR_BEGIN_CODE);
+}
+
+void DbfSizerWriteCrc(DbfSizer *z)
+{
+	assert(z);
+	DbfSizerWriteRepeat(z);
+	z->size += DBF_MAX_CRC_BYTES;
+}
+
+void DbfSizerWriteCrc32c(DbfSizer *z)
+{
+	assert(z);
+	DbfSizerWriteFormat(z, DBF_CRC32C_CODE);
+	z->size += DBF_MAX_CRC_BYTES;
+}
+
+// Gives the number of bytes the message will need, including any
+// repeat code not yet written (DbfSerializerFinalize would write it).
+unsigned long DbfSizerGetMsgLen(const DbfSizer *z)
+{
+	assert(z);
+	if (z->repeat_counter > 0)
+	{
+		return z->size + DbfSerializerEncodedLength64(DBF_REPEAT_DATANBITS, z->repeat_counter);
+	}
+	return z->size;
+}
+
+
+
+#if defined __linux__ || defined __WIN32 || __arm__
+//#if 1
+// Table for faster decoding of first byte in a code.
+/*DbfCodeTypesEnum*/ uint8_t codeTypeTable[256] = {
+		DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfNct,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,DbfRcc,
+		DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,DbfFoC,
+		DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,
+		DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,DbfNnc,
+		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
+		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
+		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
+		DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,DbfPnc,
+		DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,
 		DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,
 		DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,
 		DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,DbfExt,
@@ -1070,10 +1712,92 @@ int DbfUnserializerDecodeDataRev64(const DbfUnserializer *u, unsigned int endIdx
 }
 
 
+// Number of data bits in the start sub code, indexed by DbfCodeTypesEnum.
+// Same as DbfUnserializerDecodeData64 uses.
+static const uint8_t codeTypeDataBits[] = {
+		0, // DbfNct
+		DBF_EXT_DATANBITS, // DbfExt
+		DBF_PINT_DATANBITS, // DbfPnc
+		DBF_NINT_DATANBITS, // DbfNnc
+		DBF_FMTCRC_DATANBITS, // DbfFoC
+		DBF_REPEAT_DATANBITS, // DbfRcc
+		0, // DbfEom
+};
+
+#ifdef DBF_WIDE_LOAD_DECODER
+// Take the 7 data bits from each of the 8 bytes, the inverse of DbfSerializerSpread7.
+static uint64_t DbfUnserializerGather7(uint64_t x)
+{
+	#ifdef __BMI2__
+	return _pext_u64(x, 0x7f7f7f7f7f7f7f7fULL);
+	#else
+	x &= 0x7f7f7f7f7f7f7f7fULL;
+	x = ((x & 0x7f007f007f007f00ULL) >> 1) | (x & 0x007f007f007f007fULL);
+	x = ((x & 0x3fff00003fff0000ULL) >> 2) | (x & 0x00003fff00003fffULL);
+	x = ((x & 0x0fffffff00000000ULL) >> 4) | (x & 0x000000000fffffffULL);
+	return x;
+	#endif
+}
+#endif
+
+/**
+ * Decodes the code beginning at idx, the start sub code and then its extension
+ * sub codes (least significant bits first). Gives the index of the next code in nextIdx.
+ */
+static int64_t DbfUnserializerDecodeForward64(const DbfUnserializer *u, unsigned int idx, unsigned int *nextIdx)
+{
+	const unsigned char *p = u->msgPtr;
+	const unsigned int end = u->msgSize;
+
+	if (idx >= end)
+	{
+		*nextIdx = idx;
+		return 0;
+	}
+
+	const unsigned int nofb = codeTypeDataBits[GET_CODE_TYPE(p[idx])];
+	uint64_t data = p[idx] & ((1U << nofb) - 1);
+	unsigned int shift = nofb;
+	idx++;
+
+	#ifdef DBF_WIDE_LOAD_DECODER
+	if (idx + 8 <= end)
+	{
+		// Load the next 8 bytes, the first one without the extension bit ends the code.
+		uint64_t w;
+		memcpy(&w, p + idx, sizeof(w));
+		const uint64_t stops = ~w & 0x8080808080808080ULL;
+		if (stops)
+		{
+			const unsigned int n = __builtin_ctzll(stops) >> 3;
+			const uint64_t ext = (n == 0) ? 0 : (w & (~0ULL >> (64 - 8 * n)));
+			*nextIdx = idx + n;
+			return data | (DbfUnserializerGather7(ext) << shift);
+		}
+		// All 8 were extension sub codes, very large number, continue below.
+		data |= DbfUnserializerGather7(w) << shift;
+		shift += 8 * DBF_EXT_DATANBITS;
+		idx += 8;
+	}
+	#endif
+
+	while ((idx < end) && ((p[idx] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID))
+	{
+		if (shift < 64)
+		{
+			data |= (uint64_t)(p[idx] & DBF_EXT_DATAMASK) << shift;
+		}
+		shift += DBF_EXT_DATANBITS;
+		idx++;
+	}
+	*nextIdx = idx;
+	return data;
+}
+
 static int64_t take_next_code(DbfUnserializer *u)
 {
-	const unsigned int nextIndex = DbfUnserializerFindNextCode(u, u->readPos);
-	const int64_t code = DbfUnserializerDecodeData64(u, nextIndex);
+	unsigned int nextIndex;
+	const int64_t code = DbfUnserializerDecodeForward64(u, u->readPos, &nextIndex);
 	u->readPos = nextIndex;
 	return code;
 }
@@ -1312,7 +2036,13 @@ DBF_CRC_RESULT DbfUnserializerInitEncoding(DbfUnserializer *u, const unsigned ch
 DBF_CRC_RESULT DbfUnserializerInitReceiver(DbfUnserializer *u, const DbfReceiver *receiver)
 {
 	assert(u && receiver);
-	return DbfUnserializerInitEncoding(u, receiver->buffer, receiver->msgSize, DbfReceiverGetEncoding(receiver));
+	return DbfUnserializerInitEncoding(u, receiver->bufPtr, receiver->msgSize, DbfReceiverGetEncoding(receiver));
+}
+
+DBF_CRC_RESULT DbfUnserializerInitSlice(DbfUnserializer *u, const DbfSlice *slice)
+{
+	assert(u && slice);
+	return DbfUnserializerInitEncoding(u, slice->ptr, slice->len, slice->encoding);
 }
 
 /*static int is_ascii_message(const unsigned char *msgPtr, unsigned int msgSize)
@@ -1459,1042 +2189,2947 @@ int64_t DbfUnserializerReadInt64(DbfUnserializer *u)
 	return 0;
 }
 
+// Reads up to n integers into the array. Gives same values as calling
+// DbfUnserializerReadInt64 n times but repeat codes are expanded in one go and
+// the format code check is only done when next code is not an integer.
+// Returns the number of integers read, less than n if something else than
+// an integer was found (or end of message).
+size_t DbfUnserializerReadInt64Array(DbfUnserializer *u, int64_t *a, size_t n)
+{
+	assert(u && ((a != NULL) || (n == 0)));
+	size_t k = 0;
+	while (k < n)
+	{
+		if (u->decodeState != DbfNextIsIntegerState)
+		{
+			#ifdef DBF_AND_ASCII
+			if (u->decodeState == DbfAsciiNumberState)
+			{
+				a[k++] = DbfUnserializerReadInt64(u);
+				continue;
+			}
+			#endif
+			break;
+		}
+
+		if (u->repeat_counter > 0)
+		{
+			// Take as many of the repeated values as wanted.
+			size_t r = n - k;
+			if (u->repeat_counter < r)
+			{
+				r = u->repeat_counter;
+			}
+			u->repeat_counter -= r;
+			while (r > 0)
+			{
+				a[k++] = u->current_code;
+				--r;
+			}
+			DbfUnserializerTakeSpecial(u);
+			continue;
+		}
+
+		const DbfCodeTypesEnum t = GET_CODE_TYPE(u->msgPtr[u->readPos]);
+		int64_t code;
+		switch(t)
+		{
+			case DbfPnc:
+				code = take_next_code(u);
+				break;
+			case DbfNnc:
+				code = -take_next_code(u)-1;
+				break;
+			default:
+				// Let the regular function deal with it.
+				a[k++] = DbfUnserializerReadInt64(u);
+				continue;
+		}
+		u->current_code = code;
+		a[k++] = code;
+
+		// If another number follows there is nothing special to take.
+		if (u->readPos < u->msgSize)
+		{
+			const DbfCodeTypesEnum nt = GET_CODE_TYPE(u->msgPtr[u->readPos]);
+			if ((nt == DbfPnc) || (nt == DbfNnc))
+			{
+				continue;
+			}
+		}
+		DbfUnserializerTakeSpecial(u);
+	}
+	return k;
+}
+
 int32_t DbfUnserializerReadInt32(DbfUnserializer *u)
 {
 	// TODO Optimize for 32 bit CPU.
 	return DbfUnserializerReadInt64(u);
 }
 
-
-// Returns the length of received string.
-// A negative value if it failed.
-int DbfUnserializerRead(DbfUnserializer *u, char* bufPtr, size_t bufCap)
+// Gives the index of the first code at or after idx that can not be part of a string
+// (that is not a character or a repeat code), or msgSize if there is none.
+static unsigned int DbfFindEndOfString(const unsigned char *p, unsigned int size, unsigned int idx)
 {
-	assert(u!=NULL);
-	assert((bufPtr!=NULL) || (bufCap==0));
-
-	switch (u->decodeState)
+	#ifdef __SSE2__
+	const __m128i maxCode = _mm_set1_epi8(DBF_NINT_CODEID - 1);
+	const __m128i repeatMask = _mm_set1_epi8((char)~DBF_REPEAT_DATAMASK);
+	const __m128i repeatCode = _mm_set1_epi8(DBF_REPEAT_CODEID);
+	for (; idx + 16 <= size; idx += 16)
 	{
-		#ifdef DBF_AND_ASCII
-		case DbfAsciiNumberState:
+		const __m128i v = _mm_loadu_si128((const __m128i*)(p + idx));
+		const __m128i low = _mm_cmpeq_epi8(_mm_min_epu8(v, maxCode), v);
+		const __m128i repeat = _mm_cmpeq_epi8(_mm_and_si128(v, repeatMask), repeatCode);
+		const unsigned int m = _mm_movemask_epi8(_mm_andnot_si128(repeat, low));
+		if (m)
 		{
-			int n = 0;
-			while (is_char_part_of_number(u->msgPtr[u->readPos]))
-			{
-				if (n < bufCap)
-				{
-					bufPtr[n] = u->msgPtr[u->readPos];
-				}
-				u->readPos++;
-				n++;
-			}
-			if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-			DbfUnserializerTakeAsciiSpace(u);
-			return n;
+			return idx + DbfLowestSetBit(m);
 		}
-		case DbfAsciiWordState:
+	}
+	#endif
+	for (; idx < size; ++idx)
+	{
+		const unsigned char ch = p[idx];
+		if ((ch < DBF_NINT_CODEID) && ((ch & ~DBF_REPEAT_DATAMASK) != DBF_REPEAT_CODEID))
 		{
-			int n = 0;
-			while (is_char_part_of_word(u->msgPtr[u->readPos]))
-			{
-				if (n < bufCap)
-				{
-					bufPtr[n] = u->msgPtr[u->readPos];
-				}
-				u->readPos++;
-				n++;
-			}
-			if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-			DbfUnserializerTakeAsciiSpace(u);
-			return n;
+			return idx;
 		}
-		case DbfAsciiStringState:
+	}
+	return size;
+}
+
+// Skips n fields (integers or strings). Gives same state as reading them would,
+// empty strings are skipped as when reading and are not counted.
+// Strings are not decoded, only searched for where the next format code is.
+// Returns the number of fields skipped, less than n if the end of message was reached.
+size_t DbfUnserializerSkip(DbfUnserializer *u, size_t n)
+{
+	assert(u);
+	size_t k = 0;
+	while (k < n)
+	{
+		switch (u->decodeState)
 		{
-			int n = 0;
-			// Strings may contain quotes and if so these must be replaced with an escape sequence.
-			// We should read until end of string (endquote)  or end of message
-			for(;;)
+			case DbfNextIsIntegerState:
 			{
-				int ch = u->msgPtr[u->readPos];
-				++u->readPos;
-
-				if ((ch == 0) || (ch == '\"') || (u->readPos >= u->msgSize))
+				if (u->repeat_counter > 0)
 				{
-					DbfUnserializerTakeAsciiSpace(u);
-					return n;
+					// Skip as many of the repeated values as wanted.
+					size_t r = n - k;
+					if (u->repeat_counter < r)
+					{
+						r = u->repeat_counter;
+					}
+					u->repeat_counter -= r;
+					k += r;
+					if (u->repeat_counter == 0)
+					{
+						DbfUnserializerTakeSpecial(u);
+					}
+					break;
 				}
 
-				if (ch == '\\')
+				// Integers need to be decoded in case a repeat code follows.
+				const DbfCodeTypesEnum t = GET_CODE_TYPE(u->msgPtr[u->readPos]);
+				switch(t)
 				{
-					int x = u->msgPtr[u->readPos++];
-					if (x == 'x')
-					{
-						int h1 = u->msgPtr[u->readPos++];
-						int h2 = u->msgPtr[u->readPos++];
-						int h = (utility_decode_digit(h1) << 4) + utility_decode_digit(h2);
-						if (n < bufCap)
-						{
-							bufPtr[n] = h;
-						}
-						n++;
-					}
-					assert(u->readPos <= u->msgSize);
+					case DbfPnc:
+						u->current_code = take_next_code(u);
+						break;
+					case DbfNnc:
+						u->current_code = -take_next_code(u)-1;
+						break;
+					default:
+						// Let the regular function deal with it.
+						DbfUnserializerReadInt64(u);
+						k++;
+						continue;
 				}
-				else
+				k++;
+				if (u->readPos < u->msgSize)
 				{
-					if (n < bufCap)
+					const DbfCodeTypesEnum nt = GET_CODE_TYPE(u->msgPtr[u->readPos]);
+					if ((nt == DbfPnc) || (nt == DbfNnc))
 					{
-						bufPtr[n] = ch; //u->msgPtr[u->readPos];
+						break;
 					}
-					n++;
 				}
+				DbfUnserializerTakeSpecial(u);
+				break;
 			}
-			if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-			DbfUnserializerTakeAsciiSpace(u);
-			return n;
-		}
-		#endif
-		case DbfNextIsWordState:
-		case DbfNextIsStringState:
-		{
-			int n = 0;
-			if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
-			while ((u->decodeState == DbfNextIsWordState) || (u->decodeState == DbfNextIsStringState))
-			{
-				// Read as long as it is a code that represents characters (that is positive or negative numbers)
-				int t = DbfUnserializerGetNextType(u, u->readPos);
-
-				switch(t)
+			case DbfNextIsWordState:
+			case DbfNextIsStringState:
+				u->repeat_counter = 0;
+				u->readPos = DbfFindEndOfString(u->msgPtr, u->msgSize, u->readPos);
+				if (u->readPos >= u->msgSize)
 				{
-					case DbfNct:
-					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
-						printf("Unexpected code 0x%x\n", t);
-						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
-						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					case DbfPnc:
+					u->decodeState = DbfEndOfMsgState;
+				}
+				else
+				{
+					DbfUnserializerTakeSpecial(u);
+				}
+				k++;
+				break;
+			#ifdef DBF_AND_ASCII
+			case DbfAsciiNumberState:
+				DbfUnserializerReadInt64(u);
+				k++;
+				break;
+			case DbfAsciiWordState:
+			case DbfAsciiStringState:
+				DbfUnserializerRead(u, NULL, 0);
+				k++;
+				break;
+			#endif
+			default:
+				return k;
+		}
+	}
+	return k;
+}
+
+int DbfCommandInit(DbfCommand *c, const char *word, int id)
+{
+	assert(c && word);
+	DbfSerializer s;
+	DbfSerializerInit(&s);
+	DbfSerializerWriteWord(&s, word);
+	DbfSerializerFinalize(&s);
+	const unsigned int len = DbfSerializerGetMsgLen(&s);
+	int r = -1;
+	if (len <= sizeof(c->bytes))
+	{
+		memcpy(c->bytes, DbfSerializerGetMsgPtr(&s), len);
+		c->len = len;
+		c->id = id;
+		r = 0;
+	}
+	DbfSerializerDeinit(&s);
+	return r;
+}
+
+// A message that begins with the command must also have the word end there.
+static int DbfCommandIsEndOfWord(const unsigned char *msgPtr, unsigned int msgSize, unsigned int idx)
+{
+	return (idx >= msgSize) || (DbfFindEndOfString(msgPtr, idx + 1, idx) == idx);
+}
+
+int DbfCommandMatch(const DbfCommand *c, const unsigned char *msgPtr, unsigned int msgSize)
+{
+	assert(c && (msgPtr || (msgSize == 0)));
+	return (msgSize >= c->len) && (memcmp(msgPtr, c->bytes, c->len) == 0) && DbfCommandIsEndOfWord(msgPtr, msgSize, c->len);
+}
+
+// FNV-1a
+static uint32_t DbfCommandHash(const unsigned char *p, unsigned int len)
+{
+	uint32_t h = 2166136261UL;
+	for (unsigned int i = 0; i < len; ++i)
+	{
+		h = (h ^ p[i]) * 16777619UL;
+	}
+	return h;
+}
+
+void DbfCommandTableInit(DbfCommandTable *t, unsigned int maxCommands)
+{
+	assert(t);
+	// At most half full so that probing stays short.
+	t->nofSlots = 16;
+	while (t->nofSlots < 2 * maxCommands)
+	{
+		t->nofSlots *= 2;
+	}
+	t->slots = ST_MALLOC(t->nofSlots * sizeof(DbfCommand*));
+	memset(t->slots, 0, t->nofSlots * sizeof(DbfCommand*));
+	t->nofCommands = 0;
+	t->maxCommands = maxCommands;
+}
+
+void DbfCommandTableDeinit(DbfCommandTable *t)
+{
+	assert(t);
+	ST_FREE_SIZE(t->slots, t->nofSlots * sizeof(DbfCommand*));
+	t->nofSlots = 0;
+	t->nofCommands = 0;
+}
+
+int DbfCommandTableAdd(DbfCommandTable *t, const DbfCommand *c)
+{
+	assert(t && c);
+	if (t->nofCommands >= t->maxCommands)
+	{
+		return -1;
+	}
+	unsigned int i = DbfCommandHash(c->bytes, c->len) & (t->nofSlots - 1);
+	while (t->slots[i] != NULL)
+	{
+		if ((t->slots[i]->len == c->len) && (memcmp(t->slots[i]->bytes, c->bytes, c->len) == 0))
+		{
+			// Same command word already added.
+			return -1;
+		}
+		i = (i + 1) & (t->nofSlots - 1);
+	}
+	t->slots[i] = c;
+	t->nofCommands++;
+	return 0;
+}
+
+const DbfCommand* DbfCommandTableLookup(const DbfCommandTable *t, const unsigned char *msgPtr, unsigned int msgSize)
+{
+	assert(t && (msgPtr || (msgSize == 0)));
+	if ((msgSize == 0) || (GET_CODE_TYPE(msgPtr[0]) != DbfFoC))
+	{
+		return NULL;
+	}
+
+	// The command word is the format code and all codes after it that can be characters.
+	const unsigned int len = DbfFindEndOfString(msgPtr, msgSize, 1);
+	unsigned int i = DbfCommandHash(msgPtr, len) & (t->nofSlots - 1);
+	while (t->slots[i] != NULL)
+	{
+		const DbfCommand *c = t->slots[i];
+		if ((c->len == len) && (memcmp(c->bytes, msgPtr, len) == 0))
+		{
+			return c;
+		}
+		i = (i + 1) & (t->nofSlots - 1);
+	}
+	return NULL;
+}
+
+const DbfCommand* DbfUnserializerReadCommand(DbfUnserializer *u, const DbfCommandTable *t)
+{
+	assert(u && t);
+	if (((u->decodeState != DbfNextIsWordState) && (u->decodeState != DbfNextIsStringState)))
+	{
+		return NULL;
+	}
+	const DbfCommand *c = DbfCommandTableLookup(t, u->msgPtr, u->msgSize);
+	if ((c == NULL) || (u->readPos > c->len))
+	{
+		// Not found or the command word is not the next field.
+		return NULL;
+	}
+	u->readPos = c->len;
+	u->repeat_counter = 0;
+	u->current_code = 0;
+	if (u->readPos >= u->msgSize)
+	{
+		u->decodeState = DbfEndOfMsgState;
+	}
+	else
+	{
+		DbfUnserializerTakeSpecial(u);
+	}
+	return c;
+}
+
+void DbfIndexInit(DbfIndex *x)
+{
+	assert(x);
+	x->codeStarts = NULL;
+	x->codeStartsCapacity = 0;
+	x->entries = NULL;
+	x->nofEntries = 0;
+	x->entriesCapacity = 0;
+	x->nofFields = 0;
+}
+
+void DbfIndexDeinit(DbfIndex *x)
+{
+	assert(x);
+	if (x->codeStarts != NULL)
+	{
+		ST_FREE_SIZE(x->codeStarts, x->codeStartsCapacity * sizeof(uint64_t));
+	}
+	if (x->entries != NULL)
+	{
+		ST_FREE_SIZE(x->entries, x->entriesCapacity * sizeof(DbfIndexEntry));
+	}
+	DbfIndexInit(x);
+}
+
+// Set a bit for each byte that does not have the extension bit, those begin a code.
+static void DbfIndexFindCodeStarts(const unsigned char *p, unsigned int size, uint64_t *bits)
+{
+	unsigned int i = 0;
+	#ifdef __SSE2__
+	// Movemask gives the high bit of 16 bytes at a time.
+	for (; i + 64 <= size; i += 64)
+	{
+		const uint64_t m0 = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + i)));
+		const uint64_t m1 = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + i + 16)));
+		const uint64_t m2 = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + i + 32)));
+		const uint64_t m3 = (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + i + 48)));
+		bits[i / 64] = ~(m0 | (m1 << 16) | (m2 << 32) | (m3 << 48));
+	}
+	#endif
+	for (; i < size; i += 64)
+	{
+		const unsigned int n = ((size - i) < 64) ? (size - i) : 64;
+		uint64_t w = 0;
+		for (unsigned int j = 0; j < n; ++j)
+		{
+			if ((p[i + j] & DBF_EXT_CODEMASK) != DBF_EXT_CODEID)
+			{
+				w |= 1ULL << j;
+			}
+		}
+		bits[i / 64] = w;
+	}
+}
+
+static void DbfIndexAddEntry(DbfIndex *x, unsigned int pos, unsigned int count, unsigned char repeat, int64_t value)
+{
+	if (x->nofEntries >= x->entriesCapacity)
+	{
+		const unsigned int c = (x->entriesCapacity == 0) ? 16 : x->entriesCapacity * 2;
+		if (x->entries == NULL)
+		{
+			x->entries = ST_MALLOC(c * sizeof(DbfIndexEntry));
+		}
+		else
+		{
+			x->entries = ST_RESIZE(x->entries, x->entriesCapacity * sizeof(DbfIndexEntry), c * sizeof(DbfIndexEntry));
+		}
+		x->entriesCapacity = c;
+	}
+	DbfIndexEntry *e = &x->entries[x->nofEntries++];
+	e->pos = pos;
+	e->first = x->nofFields;
+	e->count = count;
+	e->repeat = repeat;
+	e->value = value;
+	x->nofFields += count;
+}
+
+// Gives the integer value of a Pnc or Nnc code.
+static int64_t DbfIndexDecodeInt(const DbfUnserializer *u, unsigned int pos)
+{
+	unsigned int next;
+	const int64_t code = DbfUnserializerDecodeForward64(u, pos, &next);
+	return (GET_CODE_TYPE(u->msgPtr[pos]) == DbfNnc) ? -code-1 : code;
+}
+
+int DbfUnserializerBuildIndex(const DbfUnserializer *u, DbfIndex *x)
+{
+	assert(u && x);
+	x->nofEntries = 0;
+	x->nofFields = 0;
+
+	#ifdef DBF_AND_ASCII
+	if ((u->decodeState == DbfAsciiNumberState) || (u->decodeState == DbfAsciiWordState) || (u->decodeState == DbfAsciiStringState))
+	{
+		return -1;
+	}
+	#endif
+
+	const unsigned char *p = u->msgPtr;
+	const unsigned int nofWords = (u->msgSize + 63) / 64;
+	if (nofWords > x->codeStartsCapacity)
+	{
+		if (x->codeStarts != NULL)
+		{
+			ST_FREE_SIZE(x->codeStarts, x->codeStartsCapacity * sizeof(uint64_t));
+		}
+		x->codeStarts = ST_MALLOC(nofWords * sizeof(uint64_t));
+		x->codeStartsCapacity = nofWords;
+	}
+	DbfIndexFindCodeStarts(p, u->msgSize, x->codeStarts);
+
+	// Go through the codes same as DbfUnserializerTakeSpecial and the read functions would.
+	DbfDecodingStateEnum state = DbfNextIsIntegerState;
+	long lastIntPos = -1; // The integer a repeat code repeats, after a format code it is zero.
+	long stringPos = -1; // Format code of a string that has no entry yet.
+	for (unsigned int w = 0; w < nofWords; ++w)
+	{
+		uint64_t bits = x->codeStarts[w];
+		while (bits)
+		{
+			const unsigned int pos = w * 64 + DbfLowestSetBit(bits);
+			bits &= bits - 1;
+
+			switch(GET_CODE_TYPE(p[pos]))
+			{
+				case DbfPnc:
+				case DbfNnc:
+					if (state == DbfNextIsIntegerState)
 					{
-						u->current_code = ASCII_OFFSET + take_next_code(u);
-						if (n < bufCap)
-						{
-							bufPtr[n] = u->current_code;
-						}
-						++n;
-						break;
+						DbfIndexAddEntry(x, pos, 1, 0, 0);
+						lastIntPos = pos;
 					}
-					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
+					else if (stringPos >= 0)
 					{
-						u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
-						if (n < bufCap)
-						{
-							bufPtr[n] = u->current_code;
-						}
-						n++;
-						break;
+						// First character of a string.
+						DbfIndexAddEntry(x, stringPos, 1, 0, 0);
+						stringPos = -1;
 					}
-					case DbfFoC:
-						// This means that the string ended.
-						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
-						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-
-						// Check if we have a repeat in progress. We should not.
-						assert(u->repeat_counter==0);
-
-						// Check what comes after.
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					case DbfRcc:
+					break;
+				case DbfRcc:
+					if (state == DbfNextIsIntegerState)
 					{
-						// This is a repeat on previous code.
-						int64_t code = take_next_code(u);
-						while (code > 0)
+						unsigned int next;
+						const int64_t n = DbfUnserializerDecodeForward64(u, pos, &next);
+						if (n > 0)
 						{
-							if (n < bufCap)
-							{
-								bufPtr[n] = u->current_code;
-							}
-							code--;
-							n++;
+							DbfIndexAddEntry(x, next, n, 1, (lastIntPos >= 0) ? DbfIndexDecodeInt(u, lastIntPos) : 0);
 						}
-						u->repeat_counter = 0;
-						break;
 					}
-					case DbfEom:
-						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
-						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-						assert(u->repeat_counter==0);
-						u->decodeState = DbfEndOfMsgState;
-						return n;
-					default:
-						printf("Unknown code 0x%x\n", t);
-						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
-						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
-						DbfUnserializerTakeSpecial(u);
-						return n;
+					else if (stringPos >= 0)
+					{
+						DbfIndexAddEntry(x, stringPos, 1, 0, 0);
+						stringPos = -1;
+					}
+					break;
+				case DbfFoC:
+				{
+					unsigned int next;
+					const int64_t code = DbfUnserializerDecodeForward64(u, pos, &next);
+					// A string with no characters (stringPos still set) is not a field,
+					// reading skips it, see DbfUnserializerTakeSpecial.
+					lastIntPos = -1;
+					stringPos = -1;
+					switch(code)
+					{
+						case DBF_INT_BEGIN_CODE:
+							state = DbfNextIsIntegerState;
+							break;
+						case DBF_STR_BEGIN_CODE:
+							state = DbfNextIsStringState;
+							stringPos = pos;
+							break;
+						case DBF_WORD_BEGIN_CODE:
+							state = DbfNextIsWordState;
+							stringPos = pos;
+							break;
+						default:
+							return x->nofFields;
+					}
+					break;
 				}
+				default:
+					return x->nofFields;
 			}
+		}
+	}
+	return x->nofFields;
+}
 
-			// Read and skip next code if it is a special code for message formating etc.
-			DbfUnserializerTakeSpecial(u);
+unsigned int DbfIndexGetNofFields(const DbfIndex *x)
+{
+	assert(x);
+	return x->nofFields;
+}
+
+int DbfUnserializerSeekField(DbfUnserializer *u, const DbfIndex *x, unsigned int n)
+{
+	assert(u && x);
+	if (n >= x->nofFields)
+	{
+		return -1;
+	}
+
+	// Find the last entry that begins at or before field n.
+	unsigned int lo = 0;
+	unsigned int hi = x->nofEntries - 1;
+	while (lo < hi)
+	{
+		const unsigned int mid = (lo + hi + 1) / 2;
+		if (x->entries[mid].first <= n)
+		{
+			lo = mid;
+		}
+		else
+		{
+			hi = mid - 1;
+		}
+	}
+	const DbfIndexEntry *e = &x->entries[lo];
+
+	u->readPos = e->pos;
+	u->repeat_counter = 0;
+	u->current_code = 0;
+	if (e->repeat)
+	{
+		u->decodeState = DbfNextIsIntegerState;
+		u->repeat_counter = e->count - (n - e->first);
+		u->current_code = e->value;
+	}
+	else if (GET_CODE_TYPE(u->msgPtr[e->pos]) == DbfFoC)
+	{
+		// A string (it has characters, empty ones are not indexed), take its format code.
+		unsigned int next;
+		const int64_t code = DbfUnserializerDecodeForward64(u, e->pos, &next);
+		u->readPos = next;
+		u->decodeState = (code == DBF_WORD_BEGIN_CODE) ? DbfNextIsWordState : DbfNextIsStringState;
+	}
+	else
+	{
+		u->decodeState = DbfNextIsIntegerState;
+	}
+	return 0;
+}
+
+
+#ifdef __SSE2__
+// If the 16 bytes at pos are all one byte character codes (Pnc or Nnc without
+// extension sub codes) decode them into out (unless it is NULL) and return 1.
+static int DbfDecodeSingleByteChars16(const unsigned char *p, unsigned int size, unsigned int pos, char *out)
+{
+	if ((pos + 16 > size) || ((pos + 16 < size) && ((p[pos + 16] & DBF_EXT_CODEMASK) == DBF_EXT_CODEID)))
+	{
+		return 0;
+	}
+	const __m128i v = _mm_loadu_si128((const __m128i*)(p + pos));
+
+	// Signed compare so bytes with the extension bit are also below.
+	if (_mm_movemask_epi8(_mm_cmpgt_epi8(v, _mm_set1_epi8(DBF_NINT_CODEID - 1))) != 0xffff)
+	{
+		return 0;
+	}
+	if (out != NULL)
+	{
+		// A Pnc byte is the character itself, Nnc is ASCII_OFFSET - 1 - (b - DBF_NINT_CODEID).
+		const __m128i pnc = _mm_cmpgt_epi8(v, _mm_set1_epi8(DBF_PINT_CODEID - 1));
+		const __m128i nnc = _mm_sub_epi8(_mm_set1_epi8(ASCII_OFFSET - 1 + DBF_NINT_CODEID), v);
+		_mm_storeu_si128((__m128i*)out, _mm_or_si128(_mm_and_si128(pnc, v), _mm_andnot_si128(pnc, nnc)));
+	}
+	return 1;
+}
+#endif
+
+// Returns the length of received string.
+// A negative value if it failed.
+int DbfUnserializerRead(DbfUnserializer *u, char* bufPtr, size_t bufCap)
+{
+	assert(u!=NULL);
+	assert((bufPtr!=NULL) || (bufCap==0));
+
+	switch (u->decodeState)
+	{
+		#ifdef DBF_AND_ASCII
+		case DbfAsciiNumberState:
+		{
+			int n = 0;
+			while (is_char_part_of_number(u->msgPtr[u->readPos]))
+			{
+				if (n < bufCap)
+				{
+					bufPtr[n] = u->msgPtr[u->readPos];
+				}
+				u->readPos++;
+				n++;
+			}
+			if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+			DbfUnserializerTakeAsciiSpace(u);
+			return n;
+		}
+		case DbfAsciiWordState:
+		{
+			int n = 0;
+			while (is_char_part_of_word(u->msgPtr[u->readPos]))
+			{
+				if (n < bufCap)
+				{
+					bufPtr[n] = u->msgPtr[u->readPos];
+				}
+				u->readPos++;
+				n++;
+			}
+			if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+			DbfUnserializerTakeAsciiSpace(u);
+			return n;
+		}
+		case DbfAsciiStringState:
+		{
+			int n = 0;
+			// Strings may contain quotes and if so these must be replaced with an escape sequence.
+			// We should read until end of string (endquote)  or end of message
+			for(;;)
+			{
+				int ch = u->msgPtr[u->readPos];
+				++u->readPos;
+
+				if ((ch == 0) || (ch == '\"') || (u->readPos >= u->msgSize))
+				{
+					DbfUnserializerTakeAsciiSpace(u);
+					return n;
+				}
+
+				if (ch == '\\')
+				{
+					int x = u->msgPtr[u->readPos++];
+					if (x == 'x')
+					{
+						int h1 = u->msgPtr[u->readPos++];
+						int h2 = u->msgPtr[u->readPos++];
+						int h = (utility_decode_digit(h1) << 4) + utility_decode_digit(h2);
+						if (n < bufCap)
+						{
+							bufPtr[n] = h;
+						}
+						n++;
+					}
+					assert(u->readPos <= u->msgSize);
+				}
+				else
+				{
+					if (n < bufCap)
+					{
+						bufPtr[n] = ch; //u->msgPtr[u->readPos];
+					}
+					n++;
+				}
+			}
+			if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+			DbfUnserializerTakeAsciiSpace(u);
+			return n;
+		}
+		#endif
+		case DbfNextIsWordState:
+		case DbfNextIsStringState:
+		{
+			int n = 0;
+			if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
+			while ((u->decodeState == DbfNextIsWordState) || (u->decodeState == DbfNextIsStringState))
+			{
+				#ifdef __SSE2__
+				// Take 16 characters at a time as long as these are all one byte codes.
+				if ((u->repeat_counter == 0) && (((size_t)n + 16 <= bufCap) || ((size_t)n >= bufCap)) &&
+					DbfDecodeSingleByteChars16(u->msgPtr, u->msgSize, u->readPos, ((size_t)n < bufCap) ? (bufPtr + n) : NULL))
+				{
+					const unsigned char last = u->msgPtr[u->readPos + 15];
+					u->current_code = (last >= DBF_PINT_CODEID) ? last : (ASCII_OFFSET - 1 + DBF_NINT_CODEID - last);
+					u->readPos += 16;
+					n += 16;
+					continue;
+				}
+				#endif
+
+				// Read as long as it is a code that represents characters (that is positive or negative numbers)
+				int t = DbfUnserializerGetNextType(u, u->readPos);
+
+				switch(t)
+				{
+					case DbfNct:
+					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
+						printf("Unexpected code 0x%x\n", t);
+						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
+						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					case DbfPnc:
+					{
+						u->current_code = ASCII_OFFSET + take_next_code(u);
+						if (n < bufCap)
+						{
+							bufPtr[n] = u->current_code;
+						}
+						++n;
+						break;
+					}
+					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
+					{
+						u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
+						if (n < bufCap)
+						{
+							bufPtr[n] = u->current_code;
+						}
+						n++;
+						break;
+					}
+					case DbfFoC:
+						// This means that the string ended.
+						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
+						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+
+						// Check if we have a repeat in progress. We should not.
+						assert(u->repeat_counter==0);
+
+						// Check what comes after.
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					case DbfRcc:
+					{
+						// This is a repeat on previous code.
+						int64_t code = take_next_code(u);
+						while (code > 0)
+						{
+							if (n < bufCap)
+							{
+								bufPtr[n] = u->current_code;
+							}
+							code--;
+							n++;
+						}
+						u->repeat_counter = 0;
+						break;
+					}
+					case DbfEom:
+						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
+						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+						assert(u->repeat_counter==0);
+						u->decodeState = DbfEndOfMsgState;
+						return n;
+					default:
+						printf("Unknown code 0x%x\n", t);
+						if (u->decodeState == DbfNextIsStringState) {if (n < bufCap) {bufPtr[n] = '\"';n++;}}
+						if (n < bufCap) {bufPtr[n] = 0;} else if (bufCap>0)	{bufPtr[bufCap-1] = 0;}
+						DbfUnserializerTakeSpecial(u);
+						return n;
+				}
+			}
+
+			// Read and skip next code if it is a special code for message formating etc.
+			DbfUnserializerTakeSpecial(u);
+			break;
+		}
+		default:
+			break;
+	}
+
+	printf("Not string\n");
+	if (bufCap>0) {bufPtr[0] = 0;}
+	return -1;
+}
+
+// Same as DbfUnserializerReadString but only reads the string.
+// Returns the length of received string.
+// A negative value if it failed.
+// TODO Perhaps let DbfUnserializerReadInt64 return string length if it is a string.
+// Then this method will not be needed.
+long DbfUnserializerStringLength(const DbfUnserializer *u)
+{
+	assert(u!=NULL);
+
+	// Use a copy of DbfUnserializer;
+	DbfUnserializer uc;
+	uc = *u;
+
+	switch (uc.decodeState)
+	{
+		#ifdef DBF_AND_ASCII
+		case DbfAsciiNumberState:
+		{
+			int n = 0;
+			while ((is_char_part_of_number(uc.msgPtr[uc.readPos])))
+			{
+				uc.readPos++;
+				n++;
+			}
+			return n;
+		}
+		case DbfAsciiWordState:
+		{
+			int n = 0;
+			while ((is_char_part_of_word(uc.msgPtr[uc.readPos])))
+			{
+				uc.readPos++;
+				n++;
+			}
+			return n;
+		}
+		case DbfAsciiStringState:
+		{
+			int n = 0;
+			// Strings may contain quotes and if so these must be replaced with an escape sequence.
+			// We should read until end of string (endquote)  or end of message
+			for(;;)
+			{
+				int ch = uc.msgPtr[uc.readPos++];
+
+				if ((ch == 0) || (ch == '\"') || (uc.readPos >= uc.msgSize))
+				{
+					DbfUnserializerTakeAsciiSpace(&uc);
+					return n;
+				}
+
+				if (ch == '\\')
+				{
+					uc.readPos += 4;
+					assert(uc.readPos <= uc.msgSize);
+				}
+				else
+				{
+					uc.readPos++;
+				}
+				n++;
+			}
+			return n;
+		}
+		#endif
+		case DbfNextIsWordState:
+		case DbfNextIsStringState:
+		{
+			int n = 0;
+			while ((uc.decodeState == DbfNextIsStringState) || (uc.decodeState == DbfNextIsWordState))
+			{
+				#ifdef __SSE2__
+				if (DbfDecodeSingleByteChars16(uc.msgPtr, uc.msgSize, uc.readPos, NULL))
+				{
+					uc.readPos += 16;
+					n += 16;
+					continue;
+				}
+				#endif
+
+				// Read as long as it is a code that represents characters (that is positive or negative numbers)
+				int t = DbfUnserializerGetNextType(&uc, uc.readPos);
+
+				switch(t)
+				{
+					case DbfNct:
+					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
+						printf("Unexpected code 0x%x\n", t);
+						return n;
+					case DbfPnc:
+					{
+						take_next_code(&uc);
+						++n;
+						break;
+					}
+					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
+					{
+						take_next_code(&uc);
+						n++;
+						break;
+					}
+					case DbfFoC:
+						// This means that the string ended.
+						return n;
+					case DbfRcc:
+					{
+						// This is a repeat on previous code.
+						n += take_next_code(&uc);
+						break;
+					}
+					case DbfEom:
+						return n;
+					default:
+						printf("Unknown code 0x%x\n", t);
+						return n;
+				}
+			}
+			break;
+		}
+		case DbfNextIsIntegerState:
+			return 32;
+		default:
+			printf("Illegal state %d\n", uc.decodeState);
+			break;
+	}
+	printf("Not string\n");
+	return -1;
+}
+
+struct DbfArenaBlock
+{
+	DbfArenaBlock *prev;
+	size_t capacity;
+};
+
+#define DBF_ARENA_MIN_CAPACITY 256
+
+static char* DbfArenaBlockData(DbfArenaBlock *b)
+{
+	return (char*)(b + 1);
+}
+
+static void DbfArenaAddBlock(DbfArena *a, size_t capacity)
+{
+	DbfArenaBlock *b = ST_MALLOC(sizeof(DbfArenaBlock) + capacity);
+	b->prev = a->block;
+	b->capacity = capacity;
+	a->block = b;
+	a->used = 0;
+}
+
+static void DbfArenaFreeBlocks(DbfArenaBlock *b)
+{
+	while (b != NULL)
+	{
+		DbfArenaBlock *prev = b->prev;
+		ST_FREE_SIZE(b, sizeof(DbfArenaBlock) + b->capacity);
+		b = prev;
+	}
+}
+
+void DbfArenaInit(DbfArena *a, size_t initialCapacity)
+{
+	assert(a);
+	a->block = NULL;
+	a->used = 0;
+	if (initialCapacity > 0)
+	{
+		DbfArenaAddBlock(a, initialCapacity);
+	}
+}
+
+// Only the newest (and biggest) block is kept.
+void DbfArenaReset(DbfArena *a)
+{
+	assert(a);
+	if (a->block != NULL)
+	{
+		DbfArenaFreeBlocks(a->block->prev);
+		a->block->prev = NULL;
+	}
+	a->used = 0;
+}
+
+void DbfArenaDeinit(DbfArena *a)
+{
+	assert(a);
+	DbfArenaFreeBlocks(a->block);
+	a->block = NULL;
+	a->used = 0;
+}
+
+// Make sure there are at least n free bytes in current block.
+// Strings already given out stay where they are, so a new block is added rather than resizing.
+static void DbfArenaReserve(DbfArena *a, size_t n)
+{
+	if ((a->block == NULL) || (a->block->capacity - a->used < n))
+	{
+		size_t c = (a->block == NULL) ? DBF_ARENA_MIN_CAPACITY : a->block->capacity * 2;
+		if (c < n)
+		{
+			c = n;
+		}
+		DbfArenaAddBlock(a, c);
+	}
+}
+
+// Make room for n more bytes after the len bytes at p (the string being decoded,
+// after the used part of current block). If there is not, the string is moved to a bigger block.
+static char* DbfArenaGrow(DbfArena *a, char *p, size_t len, size_t n)
+{
+	if (a->block->capacity - a->used - len >= n)
+	{
+		return p;
+	}
+	DbfArenaBlock *old = a->block;
+	const size_t oldUsed = a->used;
+	size_t c = old->capacity * 2;
+	if (c < len + n)
+	{
+		c = len + n;
+	}
+	DbfArenaAddBlock(a, c);
+	char *q = DbfArenaBlockData(a->block);
+	memcpy(q, p, len);
+	if (oldUsed == 0)
+	{
+		// Nothing else was in the old block.
+		a->block->prev = old->prev;
+		ST_FREE_SIZE(old, sizeof(DbfArenaBlock) + old->capacity);
+	}
+	return q;
+}
+
+const char* DbfUnserializerReadStringAlloc(DbfUnserializer *u, DbfArena *a, size_t *len)
+{
+	assert((u!=NULL) && (a!=NULL));
+
+	char *p;
+	size_t n = 0;
+	switch (u->decodeState)
+	{
+		#ifdef DBF_AND_ASCII
+		case DbfAsciiNumberState:
+		case DbfAsciiWordState:
+		case DbfAsciiStringState:
+		{
+			// The decoded string is never longer than what is left of the message.
+			DbfArenaReserve(a, u->msgSize - u->readPos + 1);
+			p = DbfArenaBlockData(a->block) + a->used;
+			const int k = DbfUnserializerRead(u, p, a->block->capacity - a->used);
+			if (k < 0)
+			{
+				return NULL;
+			}
+			n = k;
+			break;
+		}
+		#endif
+		case DbfNextIsWordState:
+		case DbfNextIsStringState:
+			// Decode into what is left of current block, it is only moved if that runs out.
+			DbfArenaReserve(a, 17);
+			p = DbfArenaBlockData(a->block) + a->used;
+			for (;;)
+			{
+				p = DbfArenaGrow(a, p, n, 17);
+
+				#ifdef __SSE2__
+				// Take 16 characters at a time as long as these are all one byte codes.
+				if ((u->repeat_counter == 0) && DbfDecodeSingleByteChars16(u->msgPtr, u->msgSize, u->readPos, p + n))
+				{
+					const unsigned char last = u->msgPtr[u->readPos + 15];
+					u->current_code = (last >= DBF_PINT_CODEID) ? last : (ASCII_OFFSET - 1 + DBF_NINT_CODEID - last);
+					u->readPos += 16;
+					n += 16;
+					continue;
+				}
+				#endif
+
+				const int t = DbfUnserializerGetNextType(u, u->readPos);
+				if (t == DbfPnc)
+				{
+					u->current_code = ASCII_OFFSET + take_next_code(u);
+					p[n++] = u->current_code;
+				}
+				else if (t == DbfNnc)
+				{
+					u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
+					p[n++] = u->current_code;
+				}
+				else if (t == DbfRcc)
+				{
+					// This is a repeat on previous code.
+					const int64_t code = take_next_code(u);
+					if (code > 0)
+					{
+						p = DbfArenaGrow(a, p, n, code + 1);
+						memset(p + n, u->current_code, code);
+						n += code;
+					}
+					u->repeat_counter = 0;
+				}
+				else if (t == DbfEom)
+				{
+					assert(u->repeat_counter==0);
+					u->decodeState = DbfEndOfMsgState;
+					break;
+				}
+				else
+				{
+					// DbfFoC ends the string, other codes are not expected here (same as DbfUnserializerRead).
+					if (t != DbfFoC)
+					{
+						printf("Unexpected code 0x%x\n", t);
+					}
+					DbfUnserializerTakeSpecial(u);
+					break;
+				}
+			}
+			break;
+		default:
+			return NULL;
+	}
+
+	// DbfUnserializerRead does not terminate all ascii strings, so do it here.
+	p[n] = 0;
+	a->used += n + 1;
+	if (len != NULL)
+	{
+		*len = n;
+	}
+	return p;
+}
+
+// Returns the length of received string.
+// A negative value if it failed.
+int DbfUnserializerToSerializer(DbfUnserializer *u, DbfSerializer* s)
+{
+	assert((u!=NULL) && (s!=NULL));
+
+	switch (u->decodeState)
+	{
+		#ifdef DBF_AND_ASCII
+		case DbfAsciiNumberState:
+		{
+			DbfSerializerBeginWriteNumber(s);
+
+			int n = 0;
+			while ((u->readPos < u->msgSize) && (is_char_part_of_number(u->msgPtr[u->readPos])))
+			{
+				DbfSerializerResizeIfNeeded(s, s->pos);
+				DbfSerializerPutByte(s, u->msgPtr[u->readPos]);
+				u->readPos++;
+				n++;
+			}
+
+			DbfSerializerEndWrite(s);
+
+			DbfUnserializerTakeAsciiSpace(u);
+			return n;
+		}
+		case DbfAsciiWordState:
+		{
+			DbfSerializerBeginWriteWord(s);
+
+			int n = 0;
+			while ((u->readPos < u->msgSize) && ((is_char_part_of_word(u->msgPtr[u->readPos]))))
+			{
+				DbfSerializerResizeIfNeeded(s, s->pos);
+				DbfSerializerPutByte(s, u->msgPtr[u->readPos]);
+				u->readPos++;
+				n++;
+			}
+
+			DbfSerializerEndWrite(s);
+
+			DbfUnserializerTakeAsciiSpace(u);
+			return n;
+		}
+		case DbfAsciiStringState:
+		{
+			DbfSerializerBeginWriteString(s);
+
+			int n = 0;
+			// Strings may contain quotes and if so these must be replaced with an escape sequence.
+			// We should read until end of string (endquote) or end of message
+			while (u->readPos < u->msgSize)
+			{
+				int ch = u->msgPtr[u->readPos++];
+
+				if ((ch == 0) || (ch == '\"'))
+				{
+					break;
+				}
+
+				if (ch == '\\')
+				{
+					if ((u->readPos+3) <= u->msgSize)
+					{
+						int x = u->msgPtr[u->readPos++];
+						if (x == 'x')
+						{
+							int h1 = u->msgPtr[u->readPos++];
+							int h2 = u->msgPtr[u->readPos++];
+							int h = (utility_decode_digit(h1) << 4) + utility_decode_digit(h2);
+							DbfSerializerResizeIfNeeded(s, s->pos);
+							DbfSerializerPutByte(s, h);
+						}
+						else
+						{
+							printf("not supported sequence");
+							u->decodeState = DbfEndOfMsgState;
+							return n;
+						}
+						assert(u->readPos <= u->msgSize);
+					}
+					else
+					{
+						printf("incorrect sequence");
+						u->decodeState = DbfEndOfMsgState;
+						return n;
+					}
+				}
+				else
+				{
+					DbfSerializerResizeIfNeeded(s, s->pos);
+					DbfSerializerPutByte(s, ch);
+				}
+				n++;
+			}
+
+			// Add end quote. And a temporary terminating zero?
+			DbfSerializerEndWrite(s);
+			DbfUnserializerTakeAsciiSpace(u);
+			return n;
+		}
+		#endif
+		case DbfNextIsWordState:
+		{
+			DbfSerializerBeginWriteWord(s);
+
+			int n = 0;
+			while (u->decodeState == DbfNextIsWordState)
+			{
+				// Read as long as it is a code that represents characters (that is positive or negative numbers)
+				int t = DbfUnserializerGetNextType(u, u->readPos);
+
+				switch(t)
+				{
+					case DbfNct:
+					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
+						printf("Unexpected code 0x%x\n", t);
+						DbfSerializerEndWrite(s);
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					case DbfPnc:
+					{
+						u->current_code = ASCII_OFFSET + take_next_code(u);
+						DbfSerializerResizeIfNeeded(s, s->pos);
+						DbfSerializerPutByte(s, u->current_code);
+						++n;
+						break;
+					}
+					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
+					{
+						u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
+						DbfSerializerResizeIfNeeded(s, s->pos);
+						DbfSerializerPutByte(s, u->current_code);
+						n++;
+						break;
+					}
+					case DbfFoC:
+						// This means that the string ended.
+						DbfSerializerEndWrite(s);
+
+						// Check if we have a repeat in progress. We should not.
+						assert(u->repeat_counter==0);
+
+						// Check what comes after.
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					case DbfRcc:
+					{
+						// This is a repeat on previous code.
+						int64_t code = take_next_code(u);
+						while (code > 0)
+						{
+							DbfSerializerResizeIfNeeded(s, s->pos);
+							DbfSerializerPutByte(s, u->current_code);
+							code--;
+							n++;
+						}
+						u->repeat_counter = 0;
+						break;
+					}
+					case DbfEom:
+						DbfSerializerEndWrite(s);
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					default:
+						printf("Unknown code 0x%x\n", t);
+						DbfSerializerEndWrite(s);
+						DbfUnserializerTakeSpecial(u);
+						return n;
+				}
+			}
+
+			// Read and skip next code if it is a special code for message formating etc.
+			DbfUnserializerTakeSpecial(u);
+			break;
+		}
+		case DbfNextIsStringState:
+		{
+			DbfSerializerBeginWriteString(s);
+
+			int n = 0;
+			while (u->decodeState == DbfNextIsStringState)
+			{
+				// Read as long as it is a code that represents characters (that is positive or negative numbers)
+				int t = DbfUnserializerGetNextType(u, u->readPos);
+
+				switch(t)
+				{
+					case DbfNct:
+					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
+						printf("Unexpected code 0x%x\n", t);
+						DbfSerializerEndWrite(s);
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					case DbfPnc:
+					{
+						u->current_code = ASCII_OFFSET + take_next_code(u);
+						DbfSerializerResizeIfNeeded(s, s->pos);
+						DbfSerializerPutByte(s, u->current_code);
+						++n;
+						break;
+					}
+					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
+					{
+						u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
+						DbfSerializerResizeIfNeeded(s, s->pos);
+						DbfSerializerPutByte(s, u->current_code);
+						n++;
+						break;
+					}
+					case DbfFoC:
+						// This means that the string ended.
+						DbfSerializerEndWrite(s);
+
+						// Check if we have a repeat in progress. We should not.
+						assert(u->repeat_counter==0);
+
+						// Check what comes after.
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					case DbfRcc:
+					{
+						// This is a repeat on previous code.
+						int64_t code = take_next_code(u);
+						while (code > 0)
+						{
+							DbfSerializerResizeIfNeeded(s, s->pos);
+							DbfSerializerPutByte(s, u->current_code);
+							code--;
+							n++;
+						}
+						u->repeat_counter = 0;
+						break;
+					}
+					case DbfEom:
+						DbfSerializerEndWrite(s);
+						DbfUnserializerTakeSpecial(u);
+						return n;
+					default:
+						printf("Unknown code 0x%x\n", t);
+						DbfSerializerEndWrite(s);
+						DbfUnserializerTakeSpecial(u);
+						return n;
+				}
+			}
+
+			// Read and skip next code if it is a special code for message formating etc.
+			DbfUnserializerTakeSpecial(u);
+			break;
+		}
+		case DbfNextIsIntegerState:
+		{
+			int64_t n = DbfUnserializerReadInt64(u);
+			DbfSerializerWriteInt64(s, n);
+			break;
+		}
+		default:
+			printf("Illegal decodeState %d",u->decodeState);
+			u->decodeState = DbfEndOfMsgState;
+			break;
+	}
+
+	return -1;
+}
+
+int DbfUnserializerToSerializerAll(DbfUnserializer *u, DbfSerializer* s)
+{
+	assert((u!=NULL) && (s!=NULL));
+	int n = 0;
+	while(!DbfUnserializerReadIsNextEnd(u))
+	{
+		DbfUnserializerToSerializer(u, s);
+		++n;
+	}
+	return n;
+}
+
+int DbfUnserializerReadIsNextString(const DbfUnserializer *u)
+{
+	assert(u!=NULL);
+	switch (u->decodeState)
+	{
+		#ifdef DBF_AND_ASCII
+		case DbfAsciiStringState:
+		case DbfAsciiWordState:
+			return 1;
+		#endif
+		case DbfNextIsStringState:
+			return 1;
+		default:
+			break;
+	}
+	return 0;
+}
+
+int DbfUnserializerReadIsNextInt(const DbfUnserializer *u)
+{
+	assert(u!=NULL);
+	switch (u->decodeState)
+	{
+		#ifdef DBF_AND_ASCII
+		case DbfAsciiNumberState:
+			return 1;
+		#endif
+		case DbfNextIsIntegerState:
+			return 1;
+		default:
+			break;
+	}
+	return 0;
+}
+
+int DbfUnserializerReadIsNextEnd(const DbfUnserializer *u)
+{
+	if (u->decodeState == DbfEndOfMsgState)
+	{
+		return 1;
+	}
+	assert(!((u->repeat_counter == 0) && (u->readPos >= u->msgSize)));
+	return 0;
+}
+
+/**
+ * This will take the last code in the buffer, decode and check if CRC is OK.
+ */
+DBF_CRC_RESULT DbfUnserializerReadCrc(DbfUnserializer *u)
+{
+	assert(u!=NULL);
+	if (u->msgSize==0)
+	{
+		// No message
+		return DBF_NO_CRC;
+	}
+
+	int nextCodeType;
+	int64_t nextCodeData;
+	int lastCodePos = DbfUnserializerDecodeDataRev64(u, u->msgSize, &nextCodeType, &nextCodeData);
+	// TODO Shall we allow using numbers code to send the CRC?
+	//if ((nextCodeType != DbfFoC) && (nextCodeType != DbfINT) && (nextCodeType != DbfNnr))
+	if (nextCodeType != DbfFoC)
+	{
+		//debug_log("Last code was not a CRC");
+		return DBF_NO_CRC;
+	}
+	else
+	{
+		// the CRC has been read, shorten the message.
+		u->msgSize = lastCodePos;
+		uint32_t receivedCrc=nextCodeData;
+		uint32_t calculatedCrc;
+
+		// If the code before the CRC is DBF_CRC32C_CODE then it is a CRC32C (including that code).
+		int prevCodeType = DbfNct;
+		int64_t prevCodeData = 0;
+		int prevCodePos = 0;
+		if (lastCodePos > 0)
+		{
+			prevCodePos = DbfUnserializerDecodeDataRev64(u, lastCodePos, &prevCodeType, &prevCodeData);
+		}
+		if ((prevCodeType == DbfFoC) && (prevCodeData == DBF_CRC32C_CODE))
+		{
+			calculatedCrc = crc32c_final(crc32c_update(crc32c_init(), u->msgPtr, lastCodePos));
+			u->msgSize = prevCodePos;
+		}
+		else
+		{
+			calculatedCrc = crc32_calculate(u->msgPtr, u->msgSize);
+		}
+		if (receivedCrc != calculatedCrc)
+		{
+			/*#if defined __linux__ || defined __WIN32
+			printf(LOG_PREFIX "Wrong CRC: got %04x, expected %04x\n", receivedCrc, calculatedCrc);
+			#else
+			debug_log("bad CRC");
+			#endif*/
+			return DBF_BAD_CRC;
+		}
+	}
+
+	return DBF_OK_CRC;
+}
+
+
+#if defined __linux__ || defined __WIN32
+void DbfUnserializerReadCrcAndLog(DbfUnserializer *u)
+{
+	DBF_CRC_RESULT r = DbfUnserializerReadCrc(u);
+	switch(r)
+	{
+		case DBF_BAD_CRC: printf("Bad CRC\n");break;
+		case DBF_OK_CRC: printf("OK CRC\n");break;
+		default: printf("No CRC\n");break;
+	}
+}
+#endif
+
+
+#ifndef DBF_RCV_NO_INLINE_BUFFER
+#define DBF_RCV_INLINE_BUFFER(r) ((r)->buffer)
+#define DBF_RCV_INLINE_SIZE BUFFER_SIZE_IN_BYTES
+#else
+#define DBF_RCV_INLINE_BUFFER(r) NULL
+#define DBF_RCV_INLINE_SIZE 0
+#endif
+
+// First allocation when there is no inline buffer.
+#define DBF_RCV_MIN_ALLOC_SIZE 64
+
+static int8_t DbfReceiverIsFull(DbfReceiver * r)
+{
+	return (r->msgSize>=r->maxMsgSize);
+}
+
+static long get_sys_time_ms(const DbfReceiver *r);
+
+// Make room for at least needed bytes (not more than maxMsgSize).
+// Returns 0 if OK
+static int8_t DbfReceiverReserve(DbfReceiver *r, unsigned int needed)
+{
+	if (needed > r->maxMsgSize)
+	{
+		// Checked first, capacity can be more than maxMsgSize (pool size classes).
+		return -1;
+	}
+	if (needed <= r->capacity)
+	{
+		return 0;
+	}
+	unsigned int c = (r->capacity <= r->maxMsgSize / 2) ? r->capacity * 2 : r->maxMsgSize;
+	if (c < needed)
+	{
+		c = (needed < DBF_RCV_MIN_ALLOC_SIZE) ? DBF_RCV_MIN_ALLOC_SIZE : needed;
+	}
+	unsigned char *p;
+	if (r->pool != NULL)
+	{
+		// The pool may give more than asked for, it has size classes.
+		p = DbfBufferPoolAcquire(r->pool, c, &c);
+		if (p == NULL)
+		{
+			debug_log("buffer pool cap");
+			return -1;
+		}
+	}
+	else
+	{
+		p = ST_MALLOC(c);
+	}
+	if (r->msgSize > 0)
+	{
+		memcpy(p, r->bufPtr, r->msgSize);
+	}
+	if (r->bufPtr != DBF_RCV_INLINE_BUFFER(r))
+	{
+		if (r->pool != NULL)
+		{
+			DbfBufferPoolRelease(r->pool, r->bufPtr, r->capacity);
+		}
+		else
+		{
+			ST_FREE_SIZE(r->bufPtr, r->capacity);
+		}
+	}
+	r->bufPtr = p;
+	r->capacity = c;
+	r->bigMsgTimestamp = get_sys_time_ms(r);
+	return 0;
+}
+
+static void DbfReceiverReleaseBuffer(DbfReceiver *r)
+{
+	if (r->bufPtr != DBF_RCV_INLINE_BUFFER(r))
+	{
+		if (r->pool != NULL)
+		{
+			DbfBufferPoolRelease(r->pool, r->bufPtr, r->capacity);
+		}
+		else
+		{
+			ST_FREE_SIZE(r->bufPtr, r->capacity);
+		}
+		r->bufPtr = DBF_RCV_INLINE_BUFFER(r);
+		r->capacity = DBF_RCV_INLINE_SIZE;
+	}
+}
+
+// This is an internal helper function. Not intended for users to call.
+// Returns 0 if OK
+static int8_t DbfReceiverStoreByte(DbfReceiver *r, char b)
+{
+	if (DbfReceiverReserve(r, r->msgSize + 1) == 0)
+	{
+		r->bufPtr[r->msgSize] = b;
+		r->msgSize++;
+		return 0;
+	}
+	return -1;
+}
+
+static uint64_t DbfMonotonicMs(int coarse)
+{
+	#if (defined __linux__) && (defined CLOCK_MONOTONIC)
+	struct timespec t;
+	#ifdef CLOCK_MONOTONIC_COARSE
+	clock_gettime(coarse ? CLOCK_MONOTONIC_COARSE : CLOCK_MONOTONIC, &t);
+	#else
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	#endif
+	return ((uint64_t)t.tv_sec * 1000) + (t.tv_nsec / 1000000);
+	#else
+	return (st_get_posix_time_us() / 1000);
+	#endif
+}
+
+static uint64_t DbfClockGetMonotonicMs(DbfClock *c)
+{
+	(void)c;
+	return DbfMonotonicMs(1);
+}
+
+static uint64_t DbfClockGetStoredMs(DbfClock *c)
+{
+	return c->ms;
+}
+
+void DbfClockInitMonotonic(DbfClock *c)
+{
+	assert(c);
+	c->getMs = DbfClockGetMonotonicMs;
+	c->ms = 0;
+	c->tickMs = 0;
+}
+
+void DbfClockInitCached(DbfClock *c)
+{
+	assert(c);
+	c->getMs = DbfClockGetStoredMs;
+	c->ms = DbfMonotonicMs(1);
+	c->tickMs = 0;
+}
+
+void DbfClockUpdate(DbfClock *c)
+{
+	assert(c);
+	c->ms = DbfMonotonicMs(1);
+}
+
+void DbfClockInitTick(DbfClock *c, unsigned int tickMs)
+{
+	assert(c);
+	c->getMs = DbfClockGetStoredMs;
+	c->ms = 0;
+	c->tickMs = tickMs;
+}
+
+// Does nothing for clocks that are not tick clocks (tickMs is zero for those).
+void DbfClockTick(DbfClock *c)
+{
+	assert(c);
+	c->ms += c->tickMs;
+}
+
+uint64_t DbfClockGetMs(DbfClock *c)
+{
+	assert(c);
+	return c->getMs(c);
+}
+
+static long get_sys_time_ms(const DbfReceiver *r)
+{
+	return (r->clock != NULL) ? DbfClockGetMs(r->clock) : DbfMonotonicMs(0);
+}
+
+// Same as DbfReceiverCheckTimeout, more than ms must have passed since msgtimestamp.
+static void DbfReceiverStartTimer(DbfReceiver *r, unsigned int ms)
+{
+	if (r->wheel != NULL)
+	{
+		DbfTimerStart(r->wheel, &r->timer, r->msgtimestamp + ms + 1);
+	}
+}
+
+static void DbfReceiverStopTimer(DbfReceiver *r)
+{
+	if (r->wheel != NULL)
+	{
+		DbfTimerStop(r->wheel, &r->timer);
+	}
+}
+
+// In the initial state the timer frees memory allocated for a big message,
+// same as DbfReceiverCheckTimeout, if there has been no big message for a while.
+static void DbfReceiverStartIdleTimer(DbfReceiver *r)
+{
+	if ((r->wheel != NULL) && (r->bufPtr != DBF_RCV_INLINE_BUFFER(r)))
+	{
+		DbfTimerStart(r->wheel, &r->timer, r->bigMsgTimestamp + DBF_RCV_IDLE_RELEASE_MS + 1);
+	}
+}
+
+static void enterInitialState(DbfReceiver *r)
+{
+	if (r->msgSize > DBF_RCV_INLINE_SIZE)
+	{
+		r->bigMsgTimestamp = r->msgtimestamp;
+	}
+	r->msgSize = 0;
+	if (r->pool != NULL)
+	{
+		DbfReceiverReleaseBuffer(r);
+	}
+	r->msgtimestamp = 0;
+	r->receiverState = DbfRcvInitialState;
+	DbfReceiverStopTimer(r);
+	DbfReceiverStartIdleTimer(r);
+}
+
+static void enterReceivingNoiseState(DbfReceiver *r, unsigned char ch);
+
+static void enterReceivingTxtState(DbfReceiver *r, unsigned char ch)
+{
+	if (DbfReceiverStoreByte(r, ch) != 0)
+	{
+		// No memory for it (buffer pool cap), skip the line.
+		enterReceivingNoiseState(r, ch);
+		return;
+	}
+	r->msgtimestamp = get_sys_time_ms(r);
+	r->receiverState = DbfRcvReceivingTxtState;
+	DbfReceiverStopTimer(r);
+	//debug_log("txt begin");
+}
+
+static void enterReceivingBinaryMessageState(DbfReceiver *r, unsigned char ch)
+{
+	r->msgSize = 0;
+	r->msgtimestamp = get_sys_time_ms(r);
+	r->receiverState = DbfRcvReceivingMessageState;
+	DbfReceiverStartTimer(r, DBF_RCV_TIMEOUT_MS);
+	//debug_log("DBF begin");
+}
+
+static void enterReceivingNoiseState(DbfReceiver *r, unsigned char ch)
+{
+	r->msgSize = 0;
+	if (r->pool != NULL)
+	{
+		DbfReceiverReleaseBuffer(r);
+	}
+	r->msgtimestamp = get_sys_time_ms(r);
+	r->receiverState = DbfRcvIgnoreInputState;
+	DbfReceiverStartTimer(r, IGNORE_UNTIL_SILENCE_MS);
+}
+
+static void DbfReceiverOnTimer(DbfTimer *t)
+{
+	DbfReceiver *r = (DbfReceiver*)((char*)t - offsetof(DbfReceiver, timer));
+	switch (r->receiverState)
+	{
+		case DbfRcvReceivingMessageState:
+			if (r->msgSize != 0)
+			{
+				// Same as DbfReceiverCheckTimeout, a message that timed out does not count as a big one.
+				debug_log("timeout");
+				r->msgSize = 0;
+			}
+			enterInitialState(r);
+			break;
+		case DbfRcvIgnoreInputState:
+			// It has been silent for a while now.
+			enterInitialState(r);
+			break;
+		case DbfRcvInitialState:
+			DbfReceiverReleaseBuffer(r);
+			break;
+		default:
+			break;
+	}
+}
+
+
+void DbfReceiverInit(DbfReceiver *r)
+{
+	r->bufPtr = DBF_RCV_INLINE_BUFFER(r);
+	r->capacity = DBF_RCV_INLINE_SIZE;
+	r->maxMsgSize = BUFFER_SIZE_IN_BYTES;
+	r->pool = NULL;
+	r->msgSize = 0;
+	r->bigMsgTimestamp = 0;
+	r->clock = NULL;
+	r->wheel = NULL;
+	DbfTimerInit(&r->timer, DbfReceiverOnTimer);
+	enterInitialState(r);
+}
+
+void DbfReceiverDeinit(DbfReceiver *r)
+{
+	enterInitialState(r);
+	DbfReceiverReleaseBuffer(r);
+	DbfReceiverStopTimer(r);
+}
+
+void DbfReceiverReset(DbfReceiver *r)
+{
+	enterInitialState(r);
+}
+
+void DbfReceiverSetClock(DbfReceiver *r, DbfClock *clock)
+{
+	assert(r);
+	r->clock = clock;
+}
+
+void DbfReceiverSetTimerWheel(DbfReceiver *r, DbfTimerWheel *wheel)
+{
+	assert(r);
+	DbfReceiverStopTimer(r);
+	r->wheel = wheel;
+	switch (r->receiverState)
+	{
+		case DbfRcvReceivingMessageState:
+			DbfReceiverStartTimer(r, DBF_RCV_TIMEOUT_MS);
+			break;
+		case DbfRcvIgnoreInputState:
+			DbfReceiverStartTimer(r, IGNORE_UNTIL_SILENCE_MS);
+			break;
+		case DbfRcvInitialState:
+			DbfReceiverStartIdleTimer(r);
 			break;
-		}
 		default:
 			break;
 	}
+}
 
-	printf("Not string\n");
-	if (bufCap>0) {bufPtr[0] = 0;}
-	return -1;
+void DbfReceiverSetMaxMsgSize(DbfReceiver *r, unsigned int maxMsgSize)
+{
+	assert(r);
+	enterInitialState(r);
+	DbfReceiverReleaseBuffer(r);
+	DbfReceiverStopTimer(r);
+	r->maxMsgSize = maxMsgSize;
 }
 
-// Same as DbfUnserializerReadString but only reads the string.
-// Returns the length of received string.
-// A negative value if it failed.
-// TODO Perhaps let DbfUnserializerReadInt64 return string length if it is a string.
-// Then this method will not be needed.
-long DbfUnserializerStringLength(const DbfUnserializer *u)
+void DbfReceiverSetBufferPool(DbfReceiver *r, DbfBufferPool *pool)
 {
-	assert(u!=NULL);
+	assert(r);
+	enterInitialState(r);
+	DbfReceiverReleaseBuffer(r);
+	DbfReceiverStopTimer(r);
+	r->pool = pool;
+}
 
-	// Use a copy of DbfUnserializer;
-	DbfUnserializer uc;
-	uc = *u;
+const unsigned char* DbfReceiverGetMsgPtr(const DbfReceiver *r)
+{
+	assert(r);
+	return r->bufPtr;
+}
 
-	switch (uc.decodeState)
+// Returns:
+//  0 ASCII message
+//  1 if compressed DBF
+// -1 if unknown/faulty
+encoder_states_type DbfReceiverGetEncoding(const DbfReceiver *r)
+{
+	assert(r);
+	switch(r->receiverState)
 	{
-		#ifdef DBF_AND_ASCII
-		case DbfAsciiNumberState:
-		{
-			int n = 0;
-			while ((is_char_part_of_number(uc.msgPtr[uc.readPos])))
-			{
-				uc.readPos++;
-				n++;
-			}
-			return n;
-		}
-		case DbfAsciiWordState:
-		{
-			int n = 0;
-			while ((is_char_part_of_word(uc.msgPtr[uc.readPos])))
+		case DbfRcvMessageReadyState:
+		case DbfRcvDbfReceivedState:
+		case DbfRcvDbfReceivedMoreExpectedState:
+			return 1;
+
+		case DbfRcvTxtReceivedState:
+			return 0;
+
+		case DbfRcvIgnoreInputState:
+		case DbfRcvReceivingMessageState:
+		case DbfRcvReceivingTxtState:
+		case DbfRcvInitialState:
+		case DbfRcvErrorState:
+		default: break;
+	}
+	return -1;
+}
+
+// The framing below is shared by DbfReceiver, DbfSliceReceiver and DbfReceiverBank.
+
+// Gives the state that the first character of a message leads to.
+static DbfReveiverCodeStateEnum DbfRcvStateAfterFirstChar(unsigned char ch)
+{
+	switch(ch)
+	{
+		case DBF_BEGIN_CODEID:
+			// A DBF message begin.
+			return DbfRcvReceivingMessageState;
+		case DBF_END_CODEID:
+			// this was the end of a BDF message.
+		case '\r':
+		case '\n':
+			// This was the end of an ascii text line.
+			return DbfRcvInitialState;
+		case '\t':
+			return DbfRcvReceivingTxtState;
+		default:
+			if ((ch>=' ') && (ch<='~'))
 			{
-				uc.readPos++;
-				n++;
+				// This looks like the begin of an ascii string.
+				return DbfRcvReceivingTxtState;
 			}
-			return n;
-		}
-		case DbfAsciiStringState:
-		{
-			int n = 0;
-			// Strings may contain quotes and if so these must be replaced with an escape sequence.
-			// We should read until end of string (endquote)  or end of message
-			for(;;)
-			{
-				int ch = uc.msgPtr[uc.readPos++];
+			// Not DBF and not regular 7 bit ascii, ignore.
+			return DbfRcvIgnoreInputState;
+	}
+}
 
-				if ((ch == 0) || (ch == '\"') || (uc.readPos >= uc.msgSize))
-				{
-					DbfUnserializerTakeAsciiSpace(&uc);
-					return n;
-				}
+// Gives the state that a character leads to while receiving text.
+// DbfRcvTxtReceivedState if it ended the line.
+static DbfReveiverCodeStateEnum DbfRcvStateAfterTxtChar(unsigned char ch)
+{
+	switch(ch)
+	{
+		//case '\\':
+		// TODO We could add decoding of escape sequences such as \n
+		// and \040 to allow special characters to be embedded in the
+		// ASCII line.
 
-				if (ch == '\\')
-				{
-					uc.readPos += 4;
-					assert(uc.readPos <= uc.msgSize);
-				}
-				else
-				{
-					uc.readPos++;
-				}
-				n++;
-			}
-			return n;
-		}
-		#endif
-		case DbfNextIsWordState:
-		case DbfNextIsStringState:
-		{
-			int n = 0;
-			while ((uc.decodeState == DbfNextIsStringState) || (uc.decodeState == DbfNextIsWordState))
+		case DBF_END_CODEID:
+			// Unexpected data
+			return DbfRcvInitialState;
+		case DBF_BEGIN_CODEID:
+			// A DBF message begin while receiving ascii line?
+			// Ascii lines are expected to end with LF (or CR).
+			return DbfRcvReceivingMessageState;
+		case '\r':
+		case '\n':
+			return DbfRcvTxtReceivedState;
+		default:
+			if ((ch < ' ') || (ch > '~'))
 			{
-				// Read as long as it is a code that represents characters (that is positive or negative numbers)
-				int t = DbfUnserializerGetNextType(&uc, uc.readPos);
-
-				switch(t)
-				{
-					case DbfNct:
-					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
-						printf("Unexpected code 0x%x\n", t);
-						return n;
-					case DbfPnc:
-					{
-						take_next_code(&uc);
-						++n;
-						break;
-					}
-					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
-					{
-						take_next_code(&uc);
-						n++;
-						break;
-					}
-					case DbfFoC:
-						// This means that the string ended.
-						return n;
-					case DbfRcc:
-					{
-						// This is a repeat on previous code.
-						n += take_next_code(&uc);
-						break;
-					}
-					case DbfEom:
-						return n;
-					default:
-						printf("Unknown code 0x%x\n", t);
-						return n;
-				}
+				// Unexpected data or noise
+				return DbfRcvIgnoreInputState;
 			}
+			return DbfRcvReceivingTxtState;
+	}
+}
+
+static void processFirstChar(DbfReceiver *r, unsigned char ch)
+{
+	assert(r!=NULL);
+	r->msgSize = 0;
+	switch(DbfRcvStateAfterFirstChar(ch))
+	{
+		case DbfRcvReceivingMessageState:
+			enterReceivingBinaryMessageState(r, ch);
+			break;
+		case DbfRcvReceivingTxtState:
+			enterReceivingTxtState(r, ch);
+			break;
+		case DbfRcvIgnoreInputState:
+			// TODO we should count these, perhaps report some useful error message?
+			//debug_log("unexpected char");
+			enterReceivingNoiseState(r, ch);
 			break;
-		}
-		case DbfNextIsIntegerState:
-			return 32;
 		default:
-			printf("Illegal state %d\n", uc.decodeState);
+			if (r->receiverState != DbfRcvInitialState)
+			{
+				// Called from processNoise, it has been silent for a while.
+				enterInitialState(r);
+			}
+			r->msgtimestamp = 0;
 			break;
 	}
-	printf("Not string\n");
-	return -1;
 }
 
-// Returns the length of received string.
-// A negative value if it failed.
-int DbfUnserializerToSerializer(DbfUnserializer *u, DbfSerializer* s)
+// In this state just wait for line to be silent for a while.
+static void processNoise(DbfReceiver *r, unsigned char ch)
 {
-	assert((u!=NULL) && (s!=NULL));
-
-	switch (u->decodeState)
+	assert(r!=NULL);
+	switch(ch)
 	{
-		#ifdef DBF_AND_ASCII
-		case DbfAsciiNumberState:
+		case DBF_BEGIN_CODEID:
+			// A DBF message begin.
+			enterReceivingBinaryMessageState(r, ch);
+			break;
+		default:
 		{
-			DbfSerializerBeginWriteNumber(s);
-
-			int n = 0;
-			while ((u->readPos < u->msgSize) && (is_char_part_of_number(u->msgPtr[u->readPos])))
+			// In this state just wait for line to be silent for a while.
+			// see also DbfReceiverCheckTimeout.
+			const int32_t d = get_sys_time_ms(r) - r->msgtimestamp;
+			if (d > IGNORE_UNTIL_SILENCE_MS)
 			{
-				DbfSerializerResizeIfNeeded(s, s->pos);
-				DbfSerializerPutByte(s, u->msgPtr[u->readPos]);
-				u->readPos++;
-				n++;
+				// It has been silent for a while now.
+				processFirstChar(r, ch);
 			}
-
-			DbfSerializerEndWrite(s);
-
-			DbfUnserializerTakeAsciiSpace(u);
-			return n;
-		}
-		case DbfAsciiWordState:
-		{
-			DbfSerializerBeginWriteWord(s);
-
-			int n = 0;
-			while ((u->readPos < u->msgSize) && ((is_char_part_of_word(u->msgPtr[u->readPos]))))
+			else if (((ch>=' ') && (ch<='~')) || (ch == '\n') || (ch == '\r') || (ch == '\t'))
 			{
-				DbfSerializerResizeIfNeeded(s, s->pos);
-				DbfSerializerPutByte(s, u->msgPtr[u->readPos]);
-				u->readPos++;
-				n++;
+				// Keep ignoring input.
 			}
+			else
+			{
+				// more noise, extend time.
+				r->msgtimestamp = get_sys_time_ms(r);
+				DbfReceiverStartTimer(r, IGNORE_UNTIL_SILENCE_MS);
+			}
+			break;
+		}
+	}
+}
 
-			DbfSerializerEndWrite(s);
-
-			DbfUnserializerTakeAsciiSpace(u);
-			return n;
+/**
+ * Returns
+ *  <0 : Something wrong
+ *   0 : Nothing to report, not yet a full message.
+ *  >0 : A full message has been received (number of bytes received).
+ */
+int DbfReceiverProcessCh(DbfReceiver *r, unsigned char ch)
+{
+	assert(r!=NULL);
+	switch (r->receiverState)
+	{
+		case DbfRcvInitialState:
+		{
+			// In this state: waiting for the first character of a message, DBF or ascii.
+			processFirstChar(r, ch);
+			break;
 		}
-		case DbfAsciiStringState:
+		case DbfRcvReceivingTxtState:
 		{
-			DbfSerializerBeginWriteString(s);
-
-			int n = 0;
-			// Strings may contain quotes and if so these must be replaced with an escape sequence.
-			// We should read until end of string (endquote) or end of message
-			while (u->readPos < u->msgSize)
+			switch(DbfRcvStateAfterTxtChar(ch))
 			{
-				int ch = u->msgPtr[u->readPos++];
-
-				if ((ch == 0) || (ch == '\"'))
-				{
+				case DbfRcvInitialState:
+					enterInitialState(r);
 					break;
-				}
-
-				if (ch == '\\')
-				{
-					if ((u->readPos+3) <= u->msgSize)
+				case DbfRcvReceivingMessageState:
+					debug_log("DBF inside txt");
+					enterReceivingBinaryMessageState(r, ch);
+					break;
+				case DbfRcvTxtReceivedState:
+					// Adding a terminating zero (instead of the LF (or CR))
+					if (DbfReceiverReserve(r, r->msgSize + 1) == 0)
 					{
-						int x = u->msgPtr[u->readPos++];
-						if (x == 'x')
-						{
-							int h1 = u->msgPtr[u->readPos++];
-							int h2 = u->msgPtr[u->readPos++];
-							int h = (utility_decode_digit(h1) << 4) + utility_decode_digit(h2);
-							DbfSerializerResizeIfNeeded(s, s->pos);
-							DbfSerializerPutByte(s, h);
-						}
-						else
-						{
-							printf("not supported sequence");
-							u->decodeState = DbfEndOfMsgState;
-							return n;
-						}
-						assert(u->readPos <= u->msgSize);
+						r->bufPtr[r->msgSize] = 0;
+						r->receiverState = DbfRcvTxtReceivedState;
 					}
 					else
 					{
-						printf("incorrect sequence");
-						u->decodeState = DbfEndOfMsgState;
-						return n;
+						debug_log("txt buffer full");
 					}
-				}
-				else
+					return r->msgSize;
+				case DbfRcvIgnoreInputState:
+					enterReceivingNoiseState(r, ch);
+					break;
+				default:
 				{
-					DbfSerializerResizeIfNeeded(s, s->pos);
-					DbfSerializerPutByte(s, ch);
+					const int8_t stored = DbfReceiverStoreByte(r, ch);
+					r->msgtimestamp = get_sys_time_ms(r);
+					if ((stored != 0) || DbfReceiverIsFull(r))
+					{
+						r->receiverState = DbfRcvTxtReceivedState;
+						return r->msgSize;
+					}
+					break;
 				}
-				n++;
 			}
-
-			// Add end quote. And a temporary terminating zero?
-			DbfSerializerEndWrite(s);
-			DbfUnserializerTakeAsciiSpace(u);
-			return n;
+			break;
 		}
-		#endif
-		case DbfNextIsWordState:
+		case DbfRcvReceivingMessageState:
 		{
-			DbfSerializerBeginWriteWord(s);
-
-			int n = 0;
-			while (u->decodeState == DbfNextIsWordState)
+			switch(ch)
 			{
-				// Read as long as it is a code that represents characters (that is positive or negative numbers)
-				int t = DbfUnserializerGetNextType(u, u->readPos);
-
-				switch(t)
+				case DBF_BEGIN_CODEID:
 				{
-					case DbfNct:
-					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
-						printf("Unexpected code 0x%x\n", t);
-						DbfSerializerEndWrite(s);
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					case DbfPnc:
+					if (r->msgSize == 0)
 					{
-						u->current_code = ASCII_OFFSET + take_next_code(u);
-						DbfSerializerResizeIfNeeded(s, s->pos);
-						DbfSerializerPutByte(s, u->current_code);
-						++n;
-						break;
+						// Stay in this state
+						//r->receiverState = DbfRcvReceivingMessageState;
 					}
-					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
+					else
 					{
-						u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
-						DbfSerializerResizeIfNeeded(s, s->pos);
-						DbfSerializerPutByte(s, u->current_code);
-						n++;
-						break;
+						r->receiverState = DbfRcvDbfReceivedMoreExpectedState;
+						DbfReceiverStopTimer(r);
+						//debug_log("dbf end and begin");
+						return r->msgSize;
 					}
-					case DbfFoC:
-						// This means that the string ended.
-						DbfSerializerEndWrite(s);
-
-						// Check if we have a repeat in progress. We should not.
-						assert(u->repeat_counter==0);
-
-						// Check what comes after.
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					case DbfRcc:
+					break;
+				}
+				case DBF_END_CODEID:
+				{
+					if (r->msgSize == 0)
 					{
-						// This is a repeat on previous code.
-						int64_t code = take_next_code(u);
-						while (code > 0)
-						{
-							DbfSerializerResizeIfNeeded(s, s->pos);
-							DbfSerializerPutByte(s, u->current_code);
-							code--;
-							n++;
-						}
-						u->repeat_counter = 0;
-						break;
+						enterInitialState(r);
 					}
-					case DbfEom:
-						DbfSerializerEndWrite(s);
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					default:
-						printf("Unknown code 0x%x\n", t);
-						DbfSerializerEndWrite(s);
-						DbfUnserializerTakeSpecial(u);
-						return n;
+					else
+					{
+						r->receiverState = DbfRcvDbfReceivedState;
+						DbfReceiverStopTimer(r);
+						//debug_log("dbf end");
+						return r->msgSize;
+					}
+					break;
+				}
+				default:
+				{
+					if (DbfReceiverStoreByte(r, ch) != 0)
+					{
+						// Discard the message, it was too long.
+						debug_log("dbf buffer full");
+						enterInitialState(r);
+					}
+					break;
 				}
 			}
-
-			// Read and skip next code if it is a special code for message formating etc.
-			DbfUnserializerTakeSpecial(u);
 			break;
 		}
-		case DbfNextIsStringState:
+		case DbfRcvIgnoreInputState:
 		{
-			DbfSerializerBeginWriteString(s);
-
-			int n = 0;
-			while (u->decodeState == DbfNextIsStringState)
-			{
-				// Read as long as it is a code that represents characters (that is positive or negative numbers)
-				int t = DbfUnserializerGetNextType(u, u->readPos);
+			processNoise(r, ch);
+			break;
+		}
+		default:
+		case DbfRcvTxtReceivedState:
+		case DbfRcvMessageReadyState:
+		case DbfRcvErrorState:
+			debug_log("msg cleared");
+			r->msgSize = 0;
+			return -1;
+	}
+	return 0;
+}
 
-				switch(t)
-				{
-					case DbfNct:
-					case DbfExt: // EXTENSION_CODE_TYPE, see also DBF_EXT_CODEID
-						printf("Unexpected code 0x%x\n", t);
-						DbfSerializerEndWrite(s);
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					case DbfPnc:
-					{
-						u->current_code = ASCII_OFFSET + take_next_code(u);
-						DbfSerializerResizeIfNeeded(s, s->pos);
-						DbfSerializerPutByte(s, u->current_code);
-						++n;
-						break;
-					}
-					case DbfNnc: // NEGATIVE_NUMBER_CODE_TYPE, see also DBF_NINT_CODEID
-					{
-						u->current_code = ASCII_OFFSET - 1 - take_next_code(u);
-						DbfSerializerResizeIfNeeded(s, s->pos);
-						DbfSerializerPutByte(s, u->current_code);
-						n++;
-						break;
-					}
-					case DbfFoC:
-						// This means that the string ended.
-						DbfSerializerEndWrite(s);
+int DbfReceiverIsDbf(const DbfReceiver *r)
+{
+	assert(r!=NULL);
+	return ((r->receiverState == DbfRcvDbfReceivedState) || (r->receiverState == DbfRcvDbfReceivedMoreExpectedState));
+}
 
-						// Check if we have a repeat in progress. We should not.
-						assert(u->repeat_counter==0);
+int DbfReceiverIsTxt(const DbfReceiver *r)
+{
+	assert(r!=NULL);
+	return (r->receiverState == DbfRcvTxtReceivedState);
+}
 
-						// Check what comes after.
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					case DbfRcc:
-					{
-						// This is a repeat on previous code.
-						int64_t code = take_next_code(u);
-						while (code > 0)
-						{
-							DbfSerializerResizeIfNeeded(s, s->pos);
-							DbfSerializerPutByte(s, u->current_code);
-							code--;
-							n++;
-						}
-						u->repeat_counter = 0;
-						break;
-					}
-					case DbfEom:
-						DbfSerializerEndWrite(s);
-						DbfUnserializerTakeSpecial(u);
-						return n;
-					default:
-						printf("Unknown code 0x%x\n", t);
-						DbfSerializerEndWrite(s);
-						DbfUnserializerTakeSpecial(u);
-						return n;
+// This will check for timeout in receiving of messages.
+void DbfReceiverCheckTimeout(DbfReceiver *r, int timout_ms)
+{
+	assert(r!=NULL);
+	switch (r->receiverState)
+	{
+		case DbfRcvReceivingMessageState:
+		case DbfRcvIgnoreInputState:
+		{
+			const int32_t time_since_msg_begin = get_sys_time_ms(r) - r->msgtimestamp;
+			if (time_since_msg_begin > timout_ms)
+			{
+				if (r->msgSize != 0)
+				{
+					debug_log("timeout");
+					r->msgSize = 0;
 				}
+				enterInitialState(r);
 			}
-
-			// Read and skip next code if it is a special code for message formating etc.
-			DbfUnserializerTakeSpecial(u);
 			break;
 		}
-		case DbfNextIsIntegerState:
+		case DbfRcvInitialState:
 		{
-			int64_t n = DbfUnserializerReadInt64(u);
-			DbfSerializerWriteInt64(s, n);
+			// Free memory that was allocated for big messages if there has not been any for a while.
+			if ((r->bufPtr != DBF_RCV_INLINE_BUFFER(r)) && ((int64_t)(get_sys_time_ms(r) - r->bigMsgTimestamp) > DBF_RCV_IDLE_RELEASE_MS))
+			{
+				DbfReceiverReleaseBuffer(r);
+			}
 			break;
 		}
 		default:
-			printf("Illegal decodeState %d",u->decodeState);
-			u->decodeState = DbfEndOfMsgState;
 			break;
 	}
-
-	return -1;
 }
 
-int DbfUnserializerToSerializerAll(DbfUnserializer *u, DbfSerializer* s)
+void DbfReceiverTick(DbfReceiver *r)
 {
-	assert((u!=NULL) && (s!=NULL));
-	int n = 0;
-	while(!DbfUnserializerReadIsNextEnd(u))
+	if (r->clock != NULL)
 	{
-		DbfUnserializerToSerializer(u, s);
-		++n;
+		DbfClockTick(r->clock);
 	}
-	return n;
+	DbfReceiverCheckTimeout(r, DBF_RCV_TIMEOUT_MS);
 }
 
-int DbfUnserializerReadIsNextString(const DbfUnserializer *u)
+// Gives number of bytes before the first one that is not a printable 7 bit character.
+static size_t DbfReceiverFindEndOfTxt(const unsigned char *p, size_t n)
 {
-	assert(u!=NULL);
-	switch (u->decodeState)
+	size_t i = 0;
+	#ifdef __SSE2__
+	while (i + 16 <= n)
 	{
-		#ifdef DBF_AND_ASCII
-		case DbfAsciiStringState:
-		case DbfAsciiWordState:
-			return 1;
-		#endif
-		case DbfNextIsStringState:
-			return 1;
-		default:
-			break;
+		const __m128i v = _mm_loadu_si128((const __m128i*)(p + i));
+		// Signed compare, so bytes from 128 and up are below ' '.
+		const __m128i bad = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8(' ')), _mm_cmpgt_epi8(v, _mm_set1_epi8('~')));
+		const unsigned int m = _mm_movemask_epi8(bad);
+		if (m != 0)
+		{
+			return i + DbfLowestSetBit(m);
+		}
+		i += 16;
 	}
-	return 0;
+	#endif
+	while ((i < n) && (p[i] >= ' ') && (p[i] <= '~'))
+	{
+		i++;
+	}
+	return i;
 }
 
-int DbfUnserializerReadIsNextInt(const DbfUnserializer *u)
+// Gives number of bytes before the first DBF_BEGIN_CODEID or DBF_END_CODEID.
+static size_t DbfReceiverFindDbfDelimiter(const unsigned char *p, size_t n)
 {
-	assert(u!=NULL);
-	switch (u->decodeState)
+	size_t i = 0;
+	#ifdef __SSE2__
+	// DBF_BEGIN_CODEID is 0 and DBF_END_CODEID is 1, so both are 0 when lowest bit is masked away.
+	while (i + 16 <= n)
 	{
-		#ifdef DBF_AND_ASCII
-		case DbfAsciiNumberState:
-			return 1;
-		#endif
-		case DbfNextIsIntegerState:
-			return 1;
-		default:
-			break;
+		const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i*)(p + i)), _mm_set1_epi8(~1));
+		const unsigned int m = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+		if (m != 0)
+		{
+			return i + DbfLowestSetBit(m);
+		}
+		i += 16;
 	}
-	return 0;
+	#endif
+	while ((i < n) && (p[i] != DBF_BEGIN_CODEID) && (p[i] != DBF_END_CODEID))
+	{
+		i++;
+	}
+	return i;
 }
 
-int DbfUnserializerReadIsNextEnd(const DbfUnserializer *u)
+// Gives number of bytes at p that continue a text line and fit in the message (msgSize bytes in it now).
+static size_t DbfRcvScanTxt(const unsigned char *p, size_t n, unsigned int msgSize, unsigned int maxMsgSize)
 {
-	if (u->decodeState == DbfEndOfMsgState)
-	{
-		return 1;
-	}
-	assert(!((u->repeat_counter == 0) && (u->readPos >= u->msgSize)));
-	return 0;
+	const size_t k = DbfReceiverFindEndOfTxt(p, n);
+	return (k > maxMsgSize - msgSize) ? maxMsgSize - msgSize : k;
 }
 
-/**
- * This will take the last code in the buffer, decode and check if CRC is OK.
- */
-DBF_CRC_RESULT DbfUnserializerReadCrc(DbfUnserializer *u)
+// Same as DbfRcvScanTxt for the bytes of a DBF message.
+static size_t DbfRcvScanDbf(const unsigned char *p, size_t n, unsigned int msgSize, unsigned int maxMsgSize)
 {
-	assert(u!=NULL);
-	if (u->msgSize==0)
-	{
-		// No message
-		return DBF_NO_CRC;
-	}
+	const size_t k = DbfReceiverFindDbfDelimiter(p, n);
+	return (k > maxMsgSize - msgSize) ? maxMsgSize - msgSize : k;
+}
 
-	int nextCodeType;
-	int64_t nextCodeData;
-	int lastCodePos = DbfUnserializerDecodeDataRev64(u, u->msgSize, &nextCodeType, &nextCodeData);
-	// TODO Shall we allow using numbers code to send the CRC?
-	//if ((nextCodeType != DbfFoC) && (nextCodeType != DbfINT) && (nextCodeType != DbfNnr))
-	if (nextCodeType != DbfFoC)
-	{
-		//debug_log("Last code was not a CRC");
-		return DBF_NO_CRC;
-	}
-	else
+// Same as processNoise for each byte (while not yet silent) given time is same for all of them.
+// Gives number of bytes before next DBF begin code, moreNoise is set if the time of
+// last noise shall be updated.
+static size_t DbfRcvScanNoise(const unsigned char *p, size_t n, int *moreNoise)
+{
+	const unsigned char *b = memchr(p, DBF_BEGIN_CODEID, n);
+	const size_t k = (b != NULL) ? (size_t)(b - p) : n;
+	*moreNoise = 0;
+	for (size_t i = 0; i < k; i++)
 	{
-		// the CRC has been read, shorten the message.
-		u->msgSize = lastCodePos;
-		uint32_t receivedCrc=nextCodeData;
-		uint32_t calculatedCrc = crc32_calculate(u->msgPtr, u->msgSize);
-		if (receivedCrc != calculatedCrc)
+		const unsigned char ch = p[i];
+		if (!(((ch>=' ') && (ch<='~')) || (ch == '\n') || (ch == '\r') || (ch == '\t')))
 		{
-			/*#if defined __linux__ || defined __WIN32
-			printf(LOG_PREFIX "Wrong CRC: got %04x, expected %04x\n", receivedCrc, calculatedCrc);
-			#else
-			debug_log("bad CRC");
-			#endif*/
-			return DBF_BAD_CRC;
+			*moreNoise = 1;
+			break;
 		}
 	}
-
-	return DBF_OK_CRC;
+	return k;
 }
 
-
-#if defined __linux__ || defined __WIN32
-void DbfUnserializerReadCrcAndLog(DbfUnserializer *u)
+int DbfReceiverProcessBuffer(DbfReceiver *r, const unsigned char *ptr, size_t len, DbfReceiverMessageCallback callback, void *user)
 {
-	DBF_CRC_RESULT r = DbfUnserializerReadCrc(u);
-	switch(r)
+	assert((r!=NULL) && ((ptr!=NULL) || (len==0)) && (callback!=NULL));
+
+	// One time stamp for all bytes, they were received together anyway.
+	const long now = get_sys_time_ms(r);
+	int nofMessages = 0;
+	size_t i = 0;
+	while (i < len)
 	{
-		case DBF_BAD_CRC: printf("Bad CRC\n");break;
-		case DBF_OK_CRC: printf("OK CRC\n");break;
-		default: printf("No CRC\n");break;
+		int n = 0;
+		switch (r->receiverState)
+		{
+			case DbfRcvReceivingTxtState:
+			{
+				size_t k = DbfRcvScanTxt(ptr + i, len - i, r->msgSize, r->maxMsgSize);
+				if ((k > 0) && (DbfReceiverReserve(r, r->msgSize + k) != 0))
+				{
+					// Could not get more memory, the next byte goes to DbfReceiverProcessCh that handles it.
+					k = r->capacity - r->msgSize;
+				}
+				if (k > 0)
+				{
+					memcpy(r->bufPtr + r->msgSize, ptr + i, k);
+					r->msgSize += k;
+					r->msgtimestamp = now;
+					i += k;
+					if (DbfReceiverIsFull(r))
+					{
+						r->receiverState = DbfRcvTxtReceivedState;
+						n = r->msgSize;
+					}
+					break;
+				}
+				n = DbfReceiverProcessCh(r, ptr[i++]);
+				break;
+			}
+			case DbfRcvReceivingMessageState:
+			{
+				// The byte after those that fit is given to DbfReceiverProcessCh
+				// so that too long messages are discarded same as always.
+				size_t k = DbfRcvScanDbf(ptr + i, len - i, r->msgSize, r->maxMsgSize);
+				if ((k > 0) && (DbfReceiverReserve(r, r->msgSize + k) != 0))
+				{
+					// Could not get more memory, the next byte goes to DbfReceiverProcessCh that handles it.
+					k = r->capacity - r->msgSize;
+				}
+				if (k > 0)
+				{
+					memcpy(r->bufPtr + r->msgSize, ptr + i, k);
+					r->msgSize += k;
+					i += k;
+					break;
+				}
+				n = DbfReceiverProcessCh(r, ptr[i++]);
+				break;
+			}
+			case DbfRcvIgnoreInputState:
+				if ((int32_t)(now - r->msgtimestamp) <= IGNORE_UNTIL_SILENCE_MS)
+				{
+					int moreNoise;
+					const size_t k = DbfRcvScanNoise(ptr + i, len - i, &moreNoise);
+					if (moreNoise)
+					{
+						// more noise, extend time.
+						r->msgtimestamp = now;
+						DbfReceiverStartTimer(r, IGNORE_UNTIL_SILENCE_MS);
+					}
+					if (k > 0)
+					{
+						i += k;
+						break;
+					}
+				}
+				n = DbfReceiverProcessCh(r, ptr[i++]);
+				break;
+			case DbfRcvInitialState:
+				n = DbfReceiverProcessCh(r, ptr[i++]);
+				break;
+			default:
+				// A message from an earlier call was not reset.
+				enterInitialState(r);
+				break;
+		}
+
+		if (n > 0)
+		{
+			callback(user, r);
+			nofMessages++;
+			if (r->receiverState == DbfRcvDbfReceivedMoreExpectedState)
+			{
+				// The begin code that ended this message also began next one.
+				enterReceivingBinaryMessageState(r, DBF_BEGIN_CODEID);
+			}
+			else
+			{
+				enterInitialState(r);
+			}
+		}
 	}
+	return nofMessages;
 }
-#endif
 
+void DbfSliceReceiverInit(DbfSliceReceiver *sr, unsigned char *buf, unsigned int size)
+{
+	assert(sr && buf && (size > 0));
+	sr->buf = buf;
+	sr->size = size;
+	sr->writePos = 0;
+	sr->scanPos = 0;
+	sr->frameStart = 0;
+	sr->nofOld = 0;
+	sr->receiverState = DbfRcvInitialState;
+	sr->first = 0;
+	sr->nofSlices = 0;
+	sr->nofTaken = 0;
+}
 
-static int8_t DbfReceiverIsFull(DbfReceiver * r)
+static void DbfSliceReceiverAdd(DbfSliceReceiver *sr, unsigned int begin, unsigned int end, encoder_states_type encoding)
 {
-	return (r->msgSize>=sizeof(r->buffer));
+	DbfSlice *slice = &sr->slices[(sr->first + sr->nofSlices) % DBF_SLICE_RECEIVER_MAX_SLICES];
+	slice->ptr = sr->buf + begin;
+	slice->len = end - begin;
+	slice->encoding = encoding;
+	sr->nofSlices++;
 }
 
-// This is an internal helper function. Not intended for users to call.
-// Returns 0 if OK
-static int8_t DbfReceiverStoreByte(DbfReceiver *r, char b)
+// Frame the received bytes, stops if there is no room for more slices.
+static void DbfSliceReceiverScan(DbfSliceReceiver *sr)
 {
-	if (r->msgSize<sizeof(r->buffer))
+	while ((sr->scanPos < sr->writePos) && (sr->nofSlices < DBF_SLICE_RECEIVER_MAX_SLICES))
 	{
-		r->buffer[r->msgSize] = b;
-		r->msgSize++;
-		return 0;
+		const unsigned char *p = sr->buf + sr->scanPos;
+		const unsigned int n = sr->writePos - sr->scanPos;
+		switch (sr->receiverState)
+		{
+			case DbfRcvReceivingTxtState:
+			{
+				const unsigned int k = DbfReceiverFindEndOfTxt(p, n);
+				sr->scanPos += k;
+				if (k == n)
+				{
+					break;
+				}
+				sr->receiverState = DbfRcvStateAfterTxtChar(p[k]);
+				if (sr->receiverState == DbfRcvTxtReceivedState)
+				{
+					DbfSliceReceiverAdd(sr, sr->frameStart, sr->scanPos, 0);
+					sr->receiverState = DbfRcvInitialState;
+				}
+				else if (sr->receiverState == DbfRcvReceivingMessageState)
+				{
+					sr->frameStart = sr->scanPos + 1;
+				}
+				sr->scanPos++;
+				break;
+			}
+			case DbfRcvReceivingMessageState:
+			{
+				const unsigned int k = DbfReceiverFindDbfDelimiter(p, n);
+				sr->scanPos += k;
+				if (k == n)
+				{
+					break;
+				}
+				if (sr->scanPos > sr->frameStart)
+				{
+					DbfSliceReceiverAdd(sr, sr->frameStart, sr->scanPos, 1);
+				}
+				if (p[k] == DBF_BEGIN_CODEID)
+				{
+					// The end of one message and begin of next.
+					sr->frameStart = sr->scanPos + 1;
+				}
+				else
+				{
+					sr->receiverState = DbfRcvInitialState;
+				}
+				sr->scanPos++;
+				break;
+			}
+			case DbfRcvIgnoreInputState:
+			{
+				const unsigned char ch = *p;
+				if (ch == DBF_BEGIN_CODEID)
+				{
+					sr->frameStart = sr->scanPos + 1;
+					sr->receiverState = DbfRcvReceivingMessageState;
+				}
+				else if ((ch == DBF_END_CODEID) || (ch == '\r') || (ch == '\n'))
+				{
+					sr->receiverState = DbfRcvInitialState;
+				}
+				sr->scanPos++;
+				break;
+			}
+			default:
+			{
+				sr->receiverState = DbfRcvStateAfterFirstChar(*p);
+				if (sr->receiverState == DbfRcvReceivingMessageState)
+				{
+					sr->frameStart = sr->scanPos + 1;
+				}
+				else if (sr->receiverState == DbfRcvReceivingTxtState)
+				{
+					sr->frameStart = sr->scanPos;
+				}
+				sr->scanPos++;
+				break;
+			}
+		}
 	}
-	return -1;
 }
 
-// TODO Perhaps use an internal variable incremented at tick instead?
-// To make receiver more deterministic.
-static long get_sys_time_ms()
+// Offset of first byte that is still needed, slices excluded.
+static unsigned int DbfSliceReceiverKeepFrom(const DbfSliceReceiver *sr)
 {
-	return (st_get_posix_time_us() / 1000);
+	if ((sr->receiverState == DbfRcvReceivingTxtState) || (sr->receiverState == DbfRcvReceivingMessageState))
+	{
+		return (sr->frameStart < sr->scanPos) ? sr->frameStart : sr->scanPos;
+	}
+	return sr->scanPos;
 }
 
-static void enterInitialState(DbfReceiver *r)
+// Move the unfinished message (and bytes not yet framed) to beginning of buffer.
+static void DbfSliceReceiverMoveDown(DbfSliceReceiver *sr, unsigned int from)
 {
-	r->msgSize = 0;
-	r->msgtimestamp = 0;
-	r->receiverState = DbfRcvInitialState;
+	memmove(sr->buf, sr->buf + from, sr->writePos - from);
+	sr->writePos -= from;
+	sr->scanPos -= from;
+	sr->frameStart = (sr->frameStart > from) ? sr->frameStart - from : 0;
 }
 
-static void enterReceivingTxtState(DbfReceiver *r, unsigned char ch)
+unsigned char* DbfSliceReceiverGetWritePtr(DbfSliceReceiver *sr, unsigned int *avail)
 {
-	DbfReceiverStoreByte(r, ch);
-	r->msgtimestamp = get_sys_time_ms();
-	r->receiverState = DbfRcvReceivingTxtState;
-	//debug_log("txt begin");
+	assert(sr && avail);
+
+	if (sr->nofOld > 0)
+	{
+		// Receiving continued at beginning of buffer, there is room up to the oldest slice.
+		*avail = (sr->slices[sr->first].ptr - sr->buf) - sr->writePos;
+		return sr->buf + sr->writePos;
+	}
+
+	unsigned int a = sr->size - sr->writePos;
+	if (a < sr->size / 4)
+	{
+		const unsigned int keepFrom = DbfSliceReceiverKeepFrom(sr);
+		const unsigned int keep = sr->writePos - keepFrom;
+		if (sr->nofSlices == 0)
+		{
+			if (keepFrom > 0)
+			{
+				DbfSliceReceiverMoveDown(sr, keepFrom);
+			}
+			else if ((a == 0) && (sr->scanPos == sr->writePos))
+			{
+				// The message being received is bigger than the buffer.
+				debug_log("slice buffer full");
+				sr->writePos = 0;
+				sr->scanPos = 0;
+				sr->receiverState = DbfRcvIgnoreInputState;
+			}
+		}
+		else
+		{
+			// Slices stay where they are, continue after them or at beginning of buffer if there is more room there.
+			const unsigned int oldest = sr->slices[sr->first].ptr - sr->buf;
+			if ((oldest > keep) && (oldest - keep > a))
+			{
+				DbfSliceReceiverMoveDown(sr, keepFrom);
+				sr->nofOld = sr->nofSlices;
+				*avail = oldest - sr->writePos;
+				return sr->buf + sr->writePos;
+			}
+		}
+		a = sr->size - sr->writePos;
+	}
+	*avail = a;
+	return sr->buf + sr->writePos;
 }
 
-static void enterReceivingBinaryMessageState(DbfReceiver *r, unsigned char ch)
+unsigned int DbfSliceReceiverCommit(DbfSliceReceiver *sr, unsigned int n)
 {
-	r->msgSize = 0;
-	r->msgtimestamp = get_sys_time_ms();
-	r->receiverState = DbfRcvReceivingMessageState;
-	//debug_log("DBF begin");
+	assert(sr);
+	sr->writePos += n;
+	assert(sr->writePos <= sr->size);
+	DbfSliceReceiverScan(sr);
+	return sr->nofSlices - sr->nofTaken;
 }
 
-static void enterReceivingNoiseState(DbfReceiver *r, unsigned char ch)
+int DbfSliceReceiverNext(DbfSliceReceiver *sr, DbfSlice *slice)
 {
-	r->msgSize = 0;
-	r->msgtimestamp = get_sys_time_ms();
-	r->receiverState = DbfRcvIgnoreInputState;
+	assert(sr && slice);
+	if (sr->nofTaken >= sr->nofSlices)
+	{
+		return 0;
+	}
+	*slice = sr->slices[(sr->first + sr->nofTaken) % DBF_SLICE_RECEIVER_MAX_SLICES];
+	sr->nofTaken++;
+	return 1;
 }
 
-
-void DbfReceiverInit(DbfReceiver *r)
+void DbfSliceReceiverRelease(DbfSliceReceiver *sr)
 {
-	enterInitialState(r);
+	assert(sr && (sr->nofTaken > 0));
+	sr->first = (sr->first + 1) % DBF_SLICE_RECEIVER_MAX_SLICES;
+	sr->nofSlices--;
+	sr->nofTaken--;
+	if (sr->nofOld > 0)
+	{
+		sr->nofOld--;
+	}
+	// There may be received bytes not framed since there was no room for more slices.
+	DbfSliceReceiverScan(sr);
 }
 
-void DbfReceiverDeinit(DbfReceiver *r)
+void DbfReceiverBankInit(DbfReceiverBank *b, unsigned int nofChannels, DbfBufferPool *pool)
 {
-	enterInitialState(r);
+	assert(b && pool && (nofChannels > 0));
+	b->nofChannels = nofChannels;
+	b->maxMsgSize = BUFFER_SIZE_IN_BYTES;
+	b->pool = pool;
+	b->clock = NULL;
+	b->states = ST_MALLOC(nofChannels * sizeof(uint8_t));
+	b->msgSizes = ST_MALLOC(nofChannels * sizeof(uint32_t));
+	b->timestamps = ST_MALLOC(nofChannels * sizeof(uint32_t));
+	b->bufPtrs = ST_MALLOC(nofChannels * sizeof(unsigned char*));
+	b->capacities = ST_MALLOC(nofChannels * sizeof(uint32_t));
+	for (unsigned int i = 0; i < nofChannels; i++)
+	{
+		b->states[i] = DbfRcvInitialState;
+		b->msgSizes[i] = 0;
+		b->timestamps[i] = 0;
+		b->bufPtrs[i] = NULL;
+		b->capacities[i] = 0;
+	}
 }
 
-void DbfReceiverReset(DbfReceiver *r)
+static void DbfReceiverBankReleaseBuffer(DbfReceiverBank *b, unsigned int ch)
 {
-	enterInitialState(r);
+	if (b->bufPtrs[ch] != NULL)
+	{
+		DbfBufferPoolRelease(b->pool, b->bufPtrs[ch], b->capacities[ch]);
+		b->bufPtrs[ch] = NULL;
+		b->capacities[ch] = 0;
+	}
 }
 
-// Returns:
-//  0 ASCII message
-//  1 if compressed DBF
-// -1 if unknown/faulty
-encoder_states_type DbfReceiverGetEncoding(const DbfReceiver *r)
+void DbfReceiverBankDeinit(DbfReceiverBank *b)
 {
-	assert(r);
-	switch(r->receiverState)
+	assert(b);
+	const unsigned int n = b->nofChannels;
+	for (unsigned int i = 0; i < n; i++)
 	{
-		case DbfRcvMessageReadyState:
-		case DbfRcvDbfReceivedState:
-		case DbfRcvDbfReceivedMoreExpectedState:
-			return 1;
+		DbfReceiverBankReleaseBuffer(b, i);
+	}
+	ST_FREE_SIZE(b->states, n * sizeof(uint8_t));
+	ST_FREE_SIZE(b->msgSizes, n * sizeof(uint32_t));
+	ST_FREE_SIZE(b->timestamps, n * sizeof(uint32_t));
+	ST_FREE_SIZE(b->bufPtrs, n * sizeof(unsigned char*));
+	ST_FREE_SIZE(b->capacities, n * sizeof(uint32_t));
+	b->nofChannels = 0;
+}
 
-		case DbfRcvTxtReceivedState:
-			return 0;
+void DbfReceiverBankSetClock(DbfReceiverBank *b, DbfClock *clock)
+{
+	assert(b);
+	b->clock = clock;
+}
 
-		case DbfRcvIgnoreInputState:
-		case DbfRcvReceivingMessageState:
-		case DbfRcvReceivingTxtState:
-		case DbfRcvInitialState:
-		case DbfRcvErrorState:
-		default: break;
-	}
-	return -1;
+void DbfReceiverBankReset(DbfReceiverBank *b, unsigned int ch)
+{
+	assert(b && (ch < b->nofChannels));
+	b->states[ch] = DbfRcvInitialState;
+	b->msgSizes[ch] = 0;
+	DbfReceiverBankReleaseBuffer(b, ch);
 }
 
-static void processFirstChar(DbfReceiver *r, unsigned char ch)
+void DbfReceiverBankSetMaxMsgSize(DbfReceiverBank *b, unsigned int maxMsgSize)
 {
-	assert(r!=NULL);
-	switch(ch)
+	assert(b);
+	for (unsigned int i = 0; i < b->nofChannels; i++)
 	{
-		case DBF_BEGIN_CODEID:
-			// A DBF message begin.
-			enterReceivingBinaryMessageState(r, ch);
-			break;
-		case DBF_END_CODEID:
-			// this was the end of a BDF message.
-			r->msgSize = 0;
-			r->msgtimestamp = 0;
-			break;
-		case '\r':
-		case '\n':
-			// This was the end of an ascii text line.
-			r->msgSize = 0;
-			r->msgtimestamp = 0;
-			break;
-		case '\t':
-			enterReceivingTxtState(r, ch);
-			break;
-		default:
-			r->msgSize = 0;
-			if ((ch>=' ') && (ch<='~'))
-			{
-				// This looks like the begin of an ascii string.
-				enterReceivingTxtState(r, ch);
-			}
-			else
-			{
-				// Not DBF and not regular 7 bit ascii, ignore.
-				// TODO we should count these, perhaps report some useful error message?
-				//debug_log("unexpected char");
-				enterReceivingNoiseState(r, ch);
-			}
-			break;
+		DbfReceiverBankReset(b, i);
 	}
+	b->maxMsgSize = maxMsgSize;
 }
 
-// In this state just wait for line to be silent for a while.
-static void processNoise(DbfReceiver *r, unsigned char ch)
+// Same as DbfReceiverReserve, size is the number of bytes in the buffer now.
+static int8_t DbfReceiverBankReserve(DbfReceiverBank *b, unsigned int ch, unsigned int size, unsigned int needed)
 {
-	assert(r!=NULL);
-	switch(ch)
+	if (needed > b->maxMsgSize)
 	{
-		case DBF_BEGIN_CODEID:
-			// A DBF message begin.
-			enterReceivingBinaryMessageState(r, ch);
-			break;
-		default:
-		{
-			// In this state just wait for line to be silent for a while.
-			// see also DbfReceiverCheckTimeout.
-			const int32_t d = get_sys_time_ms() - r->msgtimestamp;
-			if (d > IGNORE_UNTIL_SILENCE_MS)
-			{
-				// It has been silent for a while now.
-				processFirstChar(r, ch);
-			}
-			else if (((ch>=' ') && (ch<='~')) || (ch == '\n') || (ch == '\r') || (ch == '\t'))
-			{
-				// Keep ignoring input.
-			}
-			else
-			{
-				// more noise, extend time.
-				r->msgtimestamp = get_sys_time_ms();
-			}
-			break;
-		}
+		return -1;
+	}
+	if (needed <= b->capacities[ch])
+	{
+		return 0;
+	}
+	unsigned int c = (b->capacities[ch] <= b->maxMsgSize / 2) ? b->capacities[ch] * 2 : b->maxMsgSize;
+	if (c < needed)
+	{
+		c = needed;
+	}
+	unsigned char *p = DbfBufferPoolAcquire(b->pool, c, &c);
+	if (p == NULL)
+	{
+		debug_log("buffer pool cap");
+		return -1;
 	}
+	if (size > 0)
+	{
+		memcpy(p, b->bufPtrs[ch], size);
+	}
+	DbfReceiverBankReleaseBuffer(b, ch);
+	b->bufPtrs[ch] = p;
+	b->capacities[ch] = c;
+	return 0;
 }
 
-/**
- * Returns
- *  <0 : Something wrong
- *   0 : Nothing to report, not yet a full message.
- *  >0 : A full message has been received (number of bytes received).
- */
-int DbfReceiverProcessCh(DbfReceiver *r, unsigned char ch)
+// Frames bytes for one channel, the state is kept in locals until done.
+static int DbfReceiverBankProcessChannel(DbfReceiverBank *b, unsigned int ch, const unsigned char *ptr, size_t len, uint32_t now, DbfReceiverBankMessageCallback callback, void *user)
 {
-	assert(r!=NULL);
-	switch (r->receiverState)
+	uint8_t state = b->states[ch];
+	uint32_t size = b->msgSizes[ch];
+	uint32_t ts = b->timestamps[ch];
+	int nofMessages = 0;
+	DbfSlice msg;
+	size_t i = 0;
+	while (i < len)
 	{
-		case DbfRcvInitialState:
-		{
-			// In this state: waiting for the first character of a message, DBF or ascii.
-			processFirstChar(r, ch);
-			break;
-		}
-		case DbfRcvReceivingTxtState:
+		switch (state)
 		{
-			switch(ch)
+			case DbfRcvReceivingTxtState:
 			{
-				//case '\\':
-				// TODO We could add decoding of escape sequences such as \n
-				// and \040 to allow special characters to be embedded in the
-				// ASCII line.
-
-				case DBF_END_CODEID:
-					// Unexpected data
-					enterInitialState(r);
-					break;
-				case DBF_BEGIN_CODEID:
-					// A DBF message begin while receiving ascii line?
-					// Ascii lines are expected to end with LF (or CR).
-					debug_log("DBF inside txt");
-					enterReceivingBinaryMessageState(r, ch);
-					break;
-				case '\r':
-				case '\n':
-					// Adding a terminating zero (instead of the LF (or CR))
-					if (r->msgSize<sizeof(r->buffer))
+				size_t k = DbfRcvScanTxt(ptr + i, len - i, size, b->maxMsgSize);
+				if ((k > 0) && (DbfReceiverBankReserve(b, ch, size, size + k) != 0))
+				{
+					k = b->capacities[ch] - size;
+				}
+				if (k > 0)
+				{
+					memcpy(b->bufPtrs[ch] + size, ptr + i, k);
+					size += k;
+					ts = now;
+					i += k;
+					if (size < b->maxMsgSize)
 					{
-						r->buffer[r->msgSize] = 0;
-						r->receiverState = DbfRcvTxtReceivedState;
+						break;
 					}
-					else
+				}
+				else
+				{
+					const DbfReveiverCodeStateEnum next = DbfRcvStateAfterTxtChar(ptr[i++]);
+					if (next == DbfRcvTxtReceivedState)
 					{
-						debug_log("txt buffer full");
+						// Adding a terminating zero (instead of the LF (or CR))
+						if (DbfReceiverBankReserve(b, ch, size, size + 1) == 0)
+						{
+							b->bufPtrs[ch][size] = 0;
+						}
 					}
-					return r->msgSize;
-				default:
-					if ((ch < ' ') || (ch > '~'))
+					else if (next == DbfRcvReceivingMessageState)
 					{
-						// Unexpected data or noise
-						enterReceivingNoiseState(r, ch);
+						debug_log("DBF inside txt");
+						state = next;
+						size = 0;
+						ts = now;
+						break;
 					}
-					else
+					else if (next != DbfRcvReceivingTxtState)
 					{
-						DbfReceiverStoreByte(r, ch);
-						r->msgtimestamp = get_sys_time_ms();
-						if (DbfReceiverIsFull(r))
-						{
-							r->receiverState = DbfRcvTxtReceivedState;
-							return r->msgSize;
-						}
+						state = next;
+						size = 0;
+						ts = now;
+						DbfReceiverBankReleaseBuffer(b, ch);
+						break;
 					}
+					// else there was no memory for it, give what we have.
+				}
+				// Full or end of line.
+				msg.ptr = b->bufPtrs[ch];
+				msg.len = size;
+				msg.encoding = 0;
+				callback(user, ch, &msg);
+				nofMessages++;
+				state = DbfRcvInitialState;
+				size = 0;
+				DbfReceiverBankReleaseBuffer(b, ch);
+				break;
+			}
+			case DbfRcvReceivingMessageState:
+			{
+				size_t k = DbfRcvScanDbf(ptr + i, len - i, size, b->maxMsgSize);
+				if ((k > 0) && (DbfReceiverBankReserve(b, ch, size, size + k) != 0))
+				{
+					k = b->capacities[ch] - size;
+				}
+				if (k > 0)
+				{
+					memcpy(b->bufPtrs[ch] + size, ptr + i, k);
+					size += k;
+					i += k;
 					break;
+				}
+				const unsigned char c = ptr[i++];
+				if ((c != DBF_BEGIN_CODEID) && (c != DBF_END_CODEID))
+				{
+					// Discard the message, it was too long.
+					debug_log("dbf buffer full");
+				}
+				else if (size != 0)
+				{
+					msg.ptr = b->bufPtrs[ch];
+					msg.len = size;
+					msg.encoding = 1;
+					callback(user, ch, &msg);
+					nofMessages++;
+					// If it was the begin code it also began next one.
+					ts = now;
+				}
+				size = 0;
+				if (c != DBF_BEGIN_CODEID)
+				{
+					state = DbfRcvInitialState;
+					DbfReceiverBankReleaseBuffer(b, ch);
+				}
+				break;
 			}
-			break;
-		}
-		case DbfRcvReceivingMessageState:
-		{
-			switch(ch)
+			case DbfRcvIgnoreInputState:
 			{
-				case DBF_BEGIN_CODEID:
+				if ((int32_t)(now - ts) > IGNORE_UNTIL_SILENCE_MS)
 				{
-					if (r->msgSize == 0)
-					{
-						// Stay in this state
-						//r->receiverState = DbfRcvReceivingMessageState;
-					}
-					else
-					{
-						r->receiverState = DbfRcvDbfReceivedMoreExpectedState;
-						//debug_log("dbf end and begin");
-						return r->msgSize;
-					}
+					// It has been silent for a while now, take this byte as a first one.
+					state = DbfRcvInitialState;
 					break;
 				}
-				case DBF_END_CODEID:
+				int moreNoise;
+				const size_t k = DbfRcvScanNoise(ptr + i, len - i, &moreNoise);
+				if (moreNoise)
 				{
-					if (r->msgSize == 0)
+					// more noise, extend time.
+					ts = now;
+				}
+				i += k;
+				if (i < len)
+				{
+					// A DBF message begin.
+					i++;
+					state = DbfRcvReceivingMessageState;
+					size = 0;
+					ts = now;
+				}
+				break;
+			}
+			default:
+			{
+				// In this state: waiting for the first character of a message, DBF or ascii.
+				const unsigned char c = ptr[i++];
+				const DbfReveiverCodeStateEnum next = DbfRcvStateAfterFirstChar(c);
+				if (next == DbfRcvReceivingTxtState)
+				{
+					ts = now;
+					if (DbfReceiverBankReserve(b, ch, 0, 1) == 0)
 					{
-						enterInitialState(r);
+						b->bufPtrs[ch][0] = c;
+						size = 1;
+						state = next;
 					}
 					else
 					{
-						r->receiverState = DbfRcvDbfReceivedState;
-						//debug_log("dbf end");
-						return r->msgSize;
+						// No memory for it (buffer pool cap), skip the line.
+						state = DbfRcvIgnoreInputState;
 					}
-					break;
 				}
-				default:
+				else if (next != DbfRcvInitialState)
 				{
-					if (DbfReceiverStoreByte(r, ch) != 0)
-					{
-						// Discard the message, it was too long.
-						debug_log("dbf buffer full");
-						enterInitialState(r);
-					}
-					break;
+					state = next;
+					size = 0;
+					ts = now;
 				}
+				break;
 			}
-			break;
-		}
-		case DbfRcvIgnoreInputState:
-		{
-			processNoise(r, ch);
-			break;
 		}
-		default:
-		case DbfRcvTxtReceivedState:
-		case DbfRcvMessageReadyState:
-		case DbfRcvErrorState:
-			debug_log("msg cleared");
-			r->msgSize = 0;
-			return -1;
 	}
-	return 0;
-}
-
-int DbfReceiverIsDbf(const DbfReceiver *r)
-{
-	assert(r!=NULL);
-	return ((r->receiverState == DbfRcvDbfReceivedState) || (r->receiverState == DbfRcvDbfReceivedMoreExpectedState));
+	b->states[ch] = state;
+	b->msgSizes[ch] = size;
+	b->timestamps[ch] = ts;
+	return nofMessages;
 }
 
-int DbfReceiverIsTxt(const DbfReceiver *r)
+int DbfReceiverBankProcess(DbfReceiverBank *b, const DbfReceiverBankInput *inputs, unsigned int nofInputs, DbfReceiverBankMessageCallback callback, void *user)
 {
-	assert(r!=NULL);
-	return (r->receiverState == DbfRcvTxtReceivedState);
+	assert(b && ((inputs != NULL) || (nofInputs == 0)) && callback);
+	const uint32_t now = (b->clock != NULL) ? DbfClockGetMs(b->clock) : DbfMonotonicMs(0);
+	int nofMessages = 0;
+	for (unsigned int n = 0; n < nofInputs; n++)
+	{
+		const DbfReceiverBankInput *in = &inputs[n];
+		assert((in->channel < b->nofChannels) && ((in->ptr != NULL) || (in->len == 0)));
+		nofMessages += DbfReceiverBankProcessChannel(b, in->channel, in->ptr, in->len, now, callback, user);
+	}
+	return nofMessages;
 }
 
-// This will check for timeout in receiving of messages.
-void DbfReceiverCheckTimeout(DbfReceiver *r, int timout_ms)
+void DbfReceiverBankCheckTimeout(DbfReceiverBank *b, int timout_ms)
 {
-	assert(r!=NULL);
-	switch (r->receiverState)
+	assert(b);
+	const uint32_t now = (b->clock != NULL) ? DbfClockGetMs(b->clock) : DbfMonotonicMs(0);
+	for (unsigned int ch = 0; ch < b->nofChannels; ch++)
 	{
-		case DbfRcvReceivingMessageState:
-		case DbfRcvIgnoreInputState:
+		// Most channels are idle, only the states are looked at for those.
+		const uint8_t state = b->states[ch];
+		if ((state != DbfRcvReceivingMessageState) && (state != DbfRcvIgnoreInputState))
 		{
-			const int32_t time_since_msg_begin = get_sys_time_ms() - r->msgtimestamp;
-			if (time_since_msg_begin > timout_ms)
+			continue;
+		}
+		if ((int32_t)(now - b->timestamps[ch]) > timout_ms)
+		{
+			if (b->msgSizes[ch] != 0)
 			{
-				if (r->msgSize != 0)
-				{
-					debug_log("timeout");
-					r->msgSize = 0;
-				}
-				enterInitialState(r);
+				debug_log("timeout");
 			}
-			break;
+			DbfReceiverBankReset(b, ch);
 		}
-		default:
-			break;
 	}
 }
 
-void DbfReceiverTick(DbfReceiver *r)
-{
-	DbfReceiverCheckTimeout(r, DBF_RCV_TIMEOUT_MS);
-}
-
 #if defined __linux__ || defined __WIN32
 
 /*int DbfReceiverToString(DbfReceiver *dbfReceiver, const char* bufPtr, int bufLen)
@@ -2597,7 +5232,7 @@ int DbfReceiverLogRawData(const DbfReceiver *dbfReceiver)
 	if (DbfReceiverIsTxt(dbfReceiver))
 	{
 		printf(LOG_PREFIX "DbfReceiverLogRawData: ");
-		const unsigned char *ptr = dbfReceiver->buffer;
+		const unsigned char *ptr = dbfReceiver->bufPtr;
 		int n = dbfReceiver->msgSize;
 		for(int i=0; i<n; ++i)
 		{
@@ -2622,7 +5257,7 @@ int DbfReceiverLogRawData(const DbfReceiver *dbfReceiver)
 	}
 	else if (DbfReceiverIsDbf(dbfReceiver))
 	{
-		DbfLogBuffer("", dbfReceiver->buffer, dbfReceiver->msgSize);
+		DbfLogBuffer("", dbfReceiver->bufPtr, dbfReceiver->msgSize);
 	}
 	return 0;
 }
@@ -2669,7 +5304,7 @@ void DbfLogBufferNoCrc(const char *prefix, const unsigned char *bufPtr, int bufL
 DbfSerializer dbfTmpMessage = 
 {
 #if (!defined DBF_FIXED_MSG_SIZE)
-		0, 0,
+		0, 0, 0, 0,
 #else
 		{0},
 #endif
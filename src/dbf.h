@@ -12,6 +12,8 @@
 #include <stdint.h>
 #include <ctype.h>
 
+#include "dbf_timer.h"
+
 
 // https://www.linuxquestions.org/questions/programming-9/c-preprocessor-define-for-32-vs-64-bit-long-int-4175658579/
 #if defined(_MSC_VER) || (defined(__INTEL_COMPILER) && defined(_WIN32))
@@ -89,6 +91,8 @@
 typedef struct DbfUnserializer DbfUnserializer;
 typedef struct DbfSerializer DbfSerializer;
 typedef struct DbfReceiver DbfReceiver;
+typedef struct DbfSlice DbfSlice;
+typedef struct DbfBufferPool DbfBufferPool;
 
 void dbfDebugLog(const char *str);
 
@@ -100,6 +104,9 @@ typedef enum
 	DBF_INT_BEGIN_CODE = 0,
 	DBF_WORD_BEGIN_CODE = 1,
 	DBF_STR_BEGIN_CODE = 2,
+	// Only just before the CRC, tells that the CRC is CRC32C (Castagnoli) instead of
+	// the usual CRC32. The CRC then includes this code. See DbfSerializerWriteCrc32c.
+	DBF_CRC32C_CODE = 10,
 } dbf_format_codes;
 
 // States for the DBF serializer encoderState.
@@ -116,10 +123,15 @@ enum encoder_states_type
 	DBF_ENCODING_STR = 5,
 };
 
+// Grows the buffer of s to new_capacity, keeping its content. Returns the new buffer.
+typedef unsigned char* (*DbfSerializerResizeFunction)(DbfSerializer *s, unsigned int new_capacity);
+
 struct DbfSerializer {
 	#if !defined DBF_FIXED_MSG_SIZE
 	unsigned char *buffer;
 	unsigned int capacity;
+	unsigned char external_buffer; // Set if buffer was given by caller, see DbfSerializerInitBuffer.
+	DbfSerializerResizeFunction resize; // NULL to use ST_RESIZE, see dbf_pool.c.
 	#else
 	unsigned char buffer[DBF_FIXED_MSG_SIZE];
 	#endif
@@ -129,11 +141,18 @@ struct DbfSerializer {
 	int64_t prev_code; // also used as word separator in ascii mode.
 	unsigned long repeat_counter; // In ascii mode this is used to know if an end quote is needed.
 	#endif
+	uint32_t running_crc; // CRC of the bytes before crc_pos, see DbfSerializerEnableRunningCrc.
+	unsigned int crc_pos;
+	unsigned char running_crc_enabled;
 };
 
-// TODO Some way to know/check after if we tried to write more than there was room for in the message.
 void DbfSerializerDebug();
 void DbfSerializerInit(DbfSerializer *dbfSerializer);
+void DbfSerializerInitReserve(DbfSerializer *dbfSerializer, unsigned long nbytes);
+#if !defined DBF_FIXED_MSG_SIZE
+void DbfSerializerInitBuffer(DbfSerializer *dbfSerializer, unsigned char *buffer, unsigned int size);
+#endif
+void DbfSerializerReserve(DbfSerializer *dbfSerializer, unsigned long nbytes);
 #ifdef DBF_AND_ASCII
 void DbfSerializerInitAscii(DbfSerializer *dbfSerializer);
 void DbfSerializerSetAsciiSeparator(DbfSerializer *dbfSerializer, int64_t ch);
@@ -143,14 +162,23 @@ void DbfSerializerInitSeparator(DbfSerializer *s, int64_t ch);
 
 void DbfSerializerWriteInt32(DbfSerializer *dbfSerializer, int32_t i);
 void DbfSerializerWriteInt64(DbfSerializer *dbfSerializer, int64_t i);
+void DbfSerializerWriteInt64Array(DbfSerializer *dbfSerializer, const int64_t *a, size_t n);
 void DbfSerializerWriteString(DbfSerializer *dbfSerializer, const char *str);
 void DbfSerializerWriteWord(DbfSerializer *dbfSerializer, const char *str);
 
 void DbfSerializerReset(DbfSerializer *dbfSerializer);
 
+// Calculate the CRC while the message is written so that DbfSerializerWriteCrc need not.
+void DbfSerializerEnableRunningCrc(DbfSerializer *dbfSerializer);
+
 // Add CRC and finalize.
 void DbfSerializerWriteCrc(DbfSerializer *dbfSerializer);
 
+// Add CRC32C and finalize. Can be calculated with the crc32 instruction on
+// x86 CPUs that have SSE4.2, so faster for large messages. Only use if the
+// receiver knows about it (DbfUnserializerReadCrc does).
+void DbfSerializerWriteCrc32c(DbfSerializer *dbfSerializer);
+
 // Finalize without adding CRC.
 void DbfSerializerFinalize(DbfSerializer *dbfSerializer);
 
@@ -158,10 +186,33 @@ const unsigned char* DbfSerializerGetMsgPtr(DbfSerializer *dbfSerializer);
 
 unsigned int DbfSerializerGetMsgLen(const DbfSerializer *dbfSerializer);
 
+// To know/check after if we tried to write more than there was room for in the message.
+int DbfSerializerIsOverflow(const DbfSerializer *dbfSerializer);
+
 void DbfSerializerDeinit(DbfSerializer *dbfSerializer);
 
 void DbfSerializerAllToString(const DbfSerializer *s, char *bufPtr, size_t bufSize);
 
+// Used to know the size of a (binary) message before it is written.
+// Same sequence of calls shall be made as to the DbfSerializer.
+typedef struct DbfSizer DbfSizer;
+struct DbfSizer {
+	unsigned long size;
+	encoder_states_type encoderState;
+	int64_t prev_code;
+	unsigned long repeat_counter;
+};
+
+void DbfSizerInit(DbfSizer *dbfSizer);
+void DbfSizerWriteInt32(DbfSizer *dbfSizer, int32_t i);
+void DbfSizerWriteInt64(DbfSizer *dbfSizer, int64_t i);
+void DbfSizerWriteInt64Array(DbfSizer *dbfSizer, const int64_t *a, size_t n);
+void DbfSizerWriteString(DbfSizer *dbfSizer, const char *str);
+void DbfSizerWriteWord(DbfSizer *dbfSizer, const char *str);
+void DbfSizerWriteCrc(DbfSizer *dbfSizer);
+void DbfSizerWriteCrc32c(DbfSizer *dbfSizer);
+unsigned long DbfSizerGetMsgLen(const DbfSizer *dbfSizer);
+
 typedef enum
 {
 	DbfNextIsIntegerState,
@@ -220,17 +271,39 @@ DBF_CRC_RESULT DbfUnserializerInitAsciiSerializer(DbfUnserializer *u, const DbfS
 #endif
 DBF_CRC_RESULT DbfUnserializerInitEncoding(DbfUnserializer *u, const unsigned char *msgPtr, unsigned int msgSize, encoder_states_type encoding);
 DBF_CRC_RESULT DbfUnserializerInitReceiver(DbfUnserializer *u, const DbfReceiver *receiver);
+DBF_CRC_RESULT DbfUnserializerInitSlice(DbfUnserializer *u, const DbfSlice *slice);
 //DBF_CRC_RESULT DbfUnserializerInit(DbfUnserializer *dbfUnserializer, const unsigned char *msgPtr, unsigned int msgSize);
 
 DbfDecodingStateEnum DbfUnserializerReadCodeState(DbfUnserializer *dbfUnserializer);
 
 int32_t DbfUnserializerReadInt32(DbfUnserializer *dbfUnserializer);
 int64_t DbfUnserializerReadInt64(DbfUnserializer *dbfUnserializer);
+size_t DbfUnserializerReadInt64Array(DbfUnserializer *dbfUnserializer, int64_t *a, size_t n);
+size_t DbfUnserializerSkip(DbfUnserializer *dbfUnserializer, size_t n);
 
 
 int DbfUnserializerRead(DbfUnserializer *dbfUnserializer, char* bufPtr, size_t bufLen);
 long DbfUnserializerStringLength(const DbfUnserializer *dbfUnserializer);
 
+// A bump allocator for strings read from messages. Reset it when the strings
+// from a message are no longer needed, memory is kept for the next message.
+typedef struct DbfArenaBlock DbfArenaBlock;
+typedef struct DbfArena DbfArena;
+struct DbfArena
+{
+	DbfArenaBlock *block; // Current block, older blocks (if any) are linked from it.
+	size_t used; // Bytes used in current block.
+};
+
+void DbfArenaInit(DbfArena *dbfArena, size_t initialCapacity);
+void DbfArenaReset(DbfArena *dbfArena);
+void DbfArenaDeinit(DbfArena *dbfArena);
+
+// Reads a string or word into memory from the arena, decoding it only once.
+// Unlike DbfUnserializerRead no quotes are added. The string is zero terminated.
+// Returns NULL if next is not a string. The string is valid until the arena is reset.
+const char* DbfUnserializerReadStringAlloc(DbfUnserializer *dbfUnserializer, DbfArena *dbfArena, size_t *len);
+
 int DbfUnserializerReadIsNextString(const DbfUnserializer *dbfUnserializer);
 
 int DbfUnserializerReadIsNextInt(const DbfUnserializer *dbfUnserializer);
@@ -252,8 +325,92 @@ size_t DbfUnserializerCopyAllToString(const DbfUnserializer *u, char *bufPtr, si
 
 void DbfUnserializerDeinit(DbfUnserializer *dbfUnserializer);
 
+// An index of the fields in a binary message so that a field can be read
+// without decoding all fields before it. A field is one integer or one string/word.
+typedef struct DbfIndexEntry DbfIndexEntry;
+struct DbfIndexEntry
+{
+	unsigned int pos; // Where to continue reading (after the repeat code if repeat is set).
+	unsigned int first; // Number of the first field in this entry.
+	unsigned int count; // Number of fields, more than one only for repeat codes.
+	unsigned char repeat; // Set if this is a repeat code, then value is the repeated integer.
+	int64_t value;
+};
+
+typedef struct DbfIndex DbfIndex;
+struct DbfIndex
+{
+	uint64_t *codeStarts; // Bit i is set if a code begins at byte i in the message.
+	unsigned int codeStartsCapacity; // In 64 bit words.
+	DbfIndexEntry *entries;
+	unsigned int nofEntries;
+	unsigned int entriesCapacity;
+	unsigned int nofFields;
+};
+
+void DbfIndexInit(DbfIndex *dbfIndex);
+void DbfIndexDeinit(DbfIndex *dbfIndex);
+
+// Index the entire message (from its beginning, not from current read position).
+// Returns number of fields or -1 if not a binary message.
+// The index is valid as long as the message buffer is.
+int DbfUnserializerBuildIndex(const DbfUnserializer *dbfUnserializer, DbfIndex *dbfIndex);
+
+unsigned int DbfIndexGetNofFields(const DbfIndex *dbfIndex);
+
+// Continue reading at field n (counting from zero), same as if all fields
+// before it had been read. Returns -1 if there is no such field.
+// Fields are numbered as they are read from the beginning, so an empty string
+// or word is not a field (reading skips it), same as for DbfUnserializerSkip.
+int DbfUnserializerSeekField(DbfUnserializer *dbfUnserializer, const DbfIndex *dbfIndex, unsigned int n);
+
+// A command word encoded once so that messages beginning with it can be
+// found by comparing bytes, without decoding the characters.
+#define DBF_COMMAND_MAX_SIZE 64
+typedef struct DbfCommand DbfCommand;
+struct DbfCommand
+{
+	unsigned char bytes[DBF_COMMAND_MAX_SIZE]; // Format code and characters, same as in a message.
+	unsigned int len;
+	int id; // For the caller to use.
+};
+
+// Returns -1 if the word is too long.
+int DbfCommandInit(DbfCommand *c, const char *word, int id);
+
+// Returns 1 if the (binary) message begins with the command word.
+int DbfCommandMatch(const DbfCommand *c, const unsigned char *msgPtr, unsigned int msgSize);
+
+// A hash table of commands to find which of them a message begins with.
+// The commands are not copied so they must remain as long as the table is used.
+typedef struct DbfCommandTable DbfCommandTable;
+struct DbfCommandTable
+{
+	const DbfCommand **slots;
+	unsigned int nofSlots;
+	unsigned int nofCommands;
+	unsigned int maxCommands;
+};
+
+void DbfCommandTableInit(DbfCommandTable *t, unsigned int maxCommands);
+void DbfCommandTableDeinit(DbfCommandTable *t);
+
+// Returns -1 if the table is full or if the command word is already in it.
+int DbfCommandTableAdd(DbfCommandTable *t, const DbfCommand *c);
+
+// Gives the command the message begins with, or NULL.
+const DbfCommand* DbfCommandTableLookup(const DbfCommandTable *t, const unsigned char *msgPtr, unsigned int msgSize);
+
+// Same as DbfCommandTableLookup on the message of the unserializer. If a command
+// is found and it is the next field then the unserializer continues after it.
+const DbfCommand* DbfUnserializerReadCommand(DbfUnserializer *u, const DbfCommandTable *t);
+
 #define DBF_RCV_TIMEOUT_MS 5000
 
+// A receiver buffer allocated for a big message is freed when there has been no
+// big message for this long (see DbfReceiverSetMaxMsgSize).
+#define DBF_RCV_IDLE_RELEASE_MS 10000
+
 // Buffer size must be an even number of 32 bit words,
 // We depend on that in other parts of the program
 // when messages are copied.
@@ -273,23 +430,97 @@ typedef enum
 } DbfReveiverCodeStateEnum;
 
 
+// Time source for the receiver timeouts, in milliseconds. See DbfReceiverSetClock.
+typedef struct DbfClock DbfClock;
+struct DbfClock
+{
+	uint64_t (*getMs)(DbfClock *clock);
+	uint64_t ms; // Current time for the cached and tick clocks.
+	unsigned int tickMs;
+};
+
+// Reads the coarse monotonic clock (where there is one) each time.
+void DbfClockInitMonotonic(DbfClock *dbfClock);
+// Gives the time from last DbfClockUpdate, call that once per batch of received bytes.
+void DbfClockInitCached(DbfClock *dbfClock);
+void DbfClockUpdate(DbfClock *dbfClock);
+// Time only moves by tickMs on each DbfClockTick (DbfReceiverTick calls it),
+// so timeouts are deterministic. If receivers share one let only one of them tick it.
+void DbfClockInitTick(DbfClock *dbfClock, unsigned int tickMs);
+void DbfClockTick(DbfClock *dbfClock);
+uint64_t DbfClockGetMs(DbfClock *dbfClock);
+
+// Define DBF_RCV_NO_INLINE_BUFFER to leave the buffer out of DbfReceiver,
+// then all messages are received in allocated (or pool) memory.
+// It changes the layout of DbfReceiver so it must be same for all files,
+// DbfReceiverInit gets another name with it so that a mix does not link.
+#ifdef DBF_RCV_NO_INLINE_BUFFER
+#define DbfReceiverInit DbfReceiverInitNoInlineBuffer
+#endif
+
 struct DbfReceiver
 {
+	#ifndef DBF_RCV_NO_INLINE_BUFFER
 	unsigned char buffer[BUFFER_SIZE_IN_BYTES];
+	#endif
+	unsigned char *bufPtr; // Points to buffer or, for a big message, to allocated memory.
+	unsigned int capacity; // Of bufPtr.
+	unsigned int maxMsgSize;
 	unsigned int msgSize;
 	DbfReveiverCodeStateEnum receiverState;
 	uint64_t msgtimestamp;
+	uint64_t bigMsgTimestamp; // When allocated memory was last needed.
+	DbfClock *clock; // NULL for the default, the monotonic system clock.
+	DbfTimerWheel *wheel; // NULL if timeouts are checked by DbfReceiverCheckTimeout.
+	DbfTimer timer;
+	DbfBufferPool *pool; // NULL if memory is allocated for each receiver.
 };
 
-// This must be called any other DbfReceiver functions.
-// Can also be used to reset the buffer so next message can be received.
+// This must be called once before any other DbfReceiver functions.
+// It is not a reset: it forgets the clock, timer wheel, pool and max message size
+// and does not free memory or stop a running timer. To receive next message use
+// DbfReceiverReset, to start over call DbfReceiverDeinit before DbfReceiverInit.
 void DbfReceiverInit(DbfReceiver *dbfReceiver);
 void DbfReceiverDeinit(DbfReceiver *dbfReceiver);
 void DbfReceiverReset(DbfReceiver *dbfReceiver);
 
+// The clock must remain valid as long as the receiver uses it. NULL gives the default clock.
+void DbfReceiverSetClock(DbfReceiver *dbfReceiver, DbfClock *dbfClock);
+
+// Let a timer wheel handle the timeouts instead of calling DbfReceiverCheckTimeout.
+// The receiver has a timer only while receiving a DBF message (DBF_RCV_TIMEOUT_MS),
+// ignoring noise (until the line has been silent for a while) or holding memory
+// allocated for a big message (freed after DBF_RCV_IDLE_RELEASE_MS), so only receivers
+// that are in the middle of something cost anything. Advance the wheel with the time
+// from the same clock as the receiver uses. NULL to not use a wheel.
+void DbfReceiverSetTimerWheel(DbfReceiver *dbfReceiver, DbfTimerWheel *wheel);
+
+// Messages up to maxMsgSize bytes are received (default is BUFFER_SIZE_IN_BYTES).
+// Memory for messages bigger than BUFFER_SIZE_IN_BYTES is allocated when needed
+// and freed by DbfReceiverCheckTimeout (or the timer wheel) after DBF_RCV_IDLE_RELEASE_MS without such messages.
+void DbfReceiverSetMaxMsgSize(DbfReceiver *dbfReceiver, unsigned int maxMsgSize);
+
+// Take memory for messages from a shared pool (see dbf_buffer_pool.h) instead.
+// The memory is given back to the pool when the receiver is reset after a message,
+// so with DBF_RCV_NO_INLINE_BUFFER an idle receiver holds no buffer at all.
+// If the pool cap is reached the message is discarded (or for text, cut short).
+void DbfReceiverSetBufferPool(DbfReceiver *dbfReceiver, DbfBufferPool *pool);
+
+const unsigned char* DbfReceiverGetMsgPtr(const DbfReceiver *dbfReceiver);
+
 // Call this at every character received. Returns >0 when there is a message to process.
 int DbfReceiverProcessCh(DbfReceiver *dbfReceiver, unsigned char ch);
 
+// Called by DbfReceiverProcessBuffer for each message received. The message is in the receiver
+// (see DbfReceiverIsDbf, DbfReceiverIsTxt and DbfUnserializerInitReceiver) until the callback returns.
+typedef void (*DbfReceiverMessageCallback)(void *user, DbfReceiver *dbfReceiver);
+
+// Same as calling DbfReceiverProcessCh for each byte and DbfReceiverReset after each message,
+// but the bytes between delimiters are found and copied in bulk.
+// If a DBF message is ended by the begin code of the next one, that one is also received.
+// Returns the number of messages given to the callback.
+int DbfReceiverProcessBuffer(DbfReceiver *dbfReceiver, const unsigned char *ptr, size_t len, DbfReceiverMessageCallback callback, void *user);
+
 int DbfReceiverIsDbf(const DbfReceiver *dbfReceiver);
 int DbfReceiverIsTxt(const DbfReceiver *dbfReceiver);
 
@@ -303,6 +534,103 @@ int DbfReceiverLogRawData(const DbfReceiver *dbfReceiver);
 
 encoder_states_type DbfReceiverGetEncoding(const DbfReceiver *receiver);
 
+// A receiver that frames messages inside a buffer owned by the caller and gives
+// them as slices of that buffer, so messages are not copied. Several messages
+// can be kept at once, they must be released in the order they were taken.
+// Framing is same as DbfReceiver except:
+// - There are no timeouts, an unfinished DBF message is not dropped when the line goes silent.
+// - Noise is ignored until next DBF begin or end code or line end (not until the line is silent).
+// - A message bigger than the buffer is discarded, also text (DbfReceiver gives text cut at maxMsgSize).
+// - Text slices are not zero terminated, use len.
+#define DBF_SLICE_RECEIVER_MAX_SLICES 32
+
+struct DbfSlice
+{
+	const unsigned char *ptr;
+	unsigned int len;
+	encoder_states_type encoding; // As for DbfUnserializerInitEncoding.
+};
+
+typedef struct DbfSliceReceiver DbfSliceReceiver;
+struct DbfSliceReceiver
+{
+	unsigned char *buf;
+	unsigned int size;
+	unsigned int writePos; // Next received byte goes here.
+	unsigned int scanPos; // Bytes before this have been framed.
+	unsigned int frameStart; // First byte of the message being received.
+	unsigned int nofOld; // Slices left at the end of buffer when receiving continued from its beginning.
+	DbfReveiverCodeStateEnum receiverState;
+	DbfSlice slices[DBF_SLICE_RECEIVER_MAX_SLICES];
+	unsigned int first; // Oldest slice not released.
+	unsigned int nofSlices; // Slices not released (taken or not).
+	unsigned int nofTaken; // Slices given by DbfSliceReceiverNext not released.
+};
+
+void DbfSliceReceiverInit(DbfSliceReceiver *dbfSliceReceiver, unsigned char *buf, unsigned int size);
+
+// Gives where to put received bytes and how many there is room for. Zero room means
+// slices must be released first. A message bigger than the buffer is discarded.
+unsigned char* DbfSliceReceiverGetWritePtr(DbfSliceReceiver *dbfSliceReceiver, unsigned int *avail);
+
+// Tell that n bytes were put at the write pointer. Returns number of messages not yet taken.
+unsigned int DbfSliceReceiverCommit(DbfSliceReceiver *dbfSliceReceiver, unsigned int n);
+
+// Gives next received message. Returns 0 if there is none.
+// The slice stays valid until it is released.
+int DbfSliceReceiverNext(DbfSliceReceiver *dbfSliceReceiver, DbfSlice *slice);
+
+// Releases the oldest slice given by DbfSliceReceiverNext.
+void DbfSliceReceiverRelease(DbfSliceReceiver *dbfSliceReceiver);
+
+// Receivers for many channels, the state of each is kept in arrays (one entry per
+// channel) instead of in one DbfReceiver per channel. So the state of thousands of
+// channels fits in a few cache lines and input for many channels is framed in one call.
+// Framing and timeouts are same as DbfReceiver. A buffer is taken from the pool
+// when a message begins and given back after the message was given to the callback.
+typedef struct DbfReceiverBank DbfReceiverBank;
+struct DbfReceiverBank
+{
+	unsigned int nofChannels;
+	unsigned int maxMsgSize;
+	DbfBufferPool *pool;
+	DbfClock *clock; // NULL for the default, the monotonic system clock.
+	// Used for every input.
+	uint8_t *states; // DbfReveiverCodeStateEnum
+	uint32_t *msgSizes;
+	uint32_t *timestamps; // Low bits of the time in ms, only differences are used.
+	// Only used for channels that are receiving a message.
+	unsigned char **bufPtrs;
+	uint32_t *capacities;
+};
+
+typedef struct DbfReceiverBankInput DbfReceiverBankInput;
+struct DbfReceiverBankInput
+{
+	unsigned int channel;
+	const unsigned char *ptr;
+	size_t len;
+};
+
+// The message is only valid until the callback returns (see DbfUnserializerInitSlice).
+typedef void (*DbfReceiverBankMessageCallback)(void *user, unsigned int channel, const DbfSlice *msg);
+
+// The pool must remain valid as long as the bank uses it.
+void DbfReceiverBankInit(DbfReceiverBank *dbfReceiverBank, unsigned int nofChannels, DbfBufferPool *pool);
+void DbfReceiverBankDeinit(DbfReceiverBank *dbfReceiverBank);
+void DbfReceiverBankSetClock(DbfReceiverBank *dbfReceiverBank, DbfClock *dbfClock);
+// Default is BUFFER_SIZE_IN_BYTES, for all channels.
+void DbfReceiverBankSetMaxMsgSize(DbfReceiverBank *dbfReceiverBank, unsigned int maxMsgSize);
+void DbfReceiverBankReset(DbfReceiverBank *dbfReceiverBank, unsigned int channel);
+
+// Same as DbfReceiverProcessBuffer for each input, in the order given. Several inputs
+// may be for the same channel. The time is read once for the whole batch.
+// Returns the number of messages given to the callback.
+int DbfReceiverBankProcess(DbfReceiverBank *dbfReceiverBank, const DbfReceiverBankInput *inputs, unsigned int nofInputs, DbfReceiverBankMessageCallback callback, void *user);
+
+// Same as DbfReceiverCheckTimeout for all channels.
+void DbfReceiverBankCheckTimeout(DbfReceiverBank *dbfReceiverBank, int timout_ms);
+
 #if defined __linux__ || defined __WIN32
 void DbfLogBuffer(const char* prefix, const unsigned char *bufPtr, int bufLen);
 void DbfLogBufferNoCrc(const char* prefix, const unsigned char *bufPtr, int bufLen);
@@ -0,0 +1,187 @@
+/*
+ * dbf_buffer_pool.c
+ *
+ * Receive buffers in size classes. Idle receivers hold no buffer at all, a
+ * buffer is taken when a message begins and given back when it has been
+ * consumed, so memory follows the number of messages in progress rather
+ * than the number of receivers.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "sys_time.h"
+#include "dbf_buffer_pool.h"
+
+static unsigned int class_size(unsigned int c)
+{
+	return DBF_BUFFER_POOL_MIN_SIZE << c;
+}
+
+// Smallest class that fits size, DBF_BUFFER_POOL_NOF_CLASSES if none does.
+static unsigned int class_of(size_t size)
+{
+	unsigned int c = 0;
+	while ((c < DBF_BUFFER_POOL_NOF_CLASSES) && (class_size(c) < size))
+	{
+		c++;
+	}
+	return c;
+}
+
+static void add_bytes(DbfBufferPool *pool, long n)
+{
+	pool->stats.current_bytes += n;
+	if (pool->stats.current_bytes > pool->stats.peak_bytes)
+	{
+		pool->stats.peak_bytes = pool->stats.current_bytes;
+	}
+}
+
+// Mutex must be taken when calling this.
+static void* take_free(DbfBufferPool *pool, unsigned int c)
+{
+	void *buf = pool->free_lists[c];
+	pool->free_lists[c] = *(void**)buf;
+	pool->free_count[c]--;
+	pool->stats.free_bytes -= class_size(c);
+	return buf;
+}
+
+// Free unused buffers, biggest first, until n more bytes fit under the cap.
+// Mutex must be taken when calling this.
+static void make_room(DbfBufferPool *pool, size_t n)
+{
+	unsigned int c = DBF_BUFFER_POOL_NOF_CLASSES;
+	while ((pool->stats.current_bytes + n > pool->cap_bytes) && (c > 0))
+	{
+		if (pool->free_count[c - 1] == 0)
+		{
+			c--;
+			continue;
+		}
+		void *buf = take_free(pool, c - 1);
+		ST_FREE_SIZE(buf, class_size(c - 1));
+		add_bytes(pool, -(long)class_size(c - 1));
+	}
+}
+
+void DbfBufferPoolInit(DbfBufferPool *pool, size_t cap_bytes, DbfBufferPoolOverflowPolicy policy, unsigned int max_free)
+{
+	assert(pool);
+	pthread_mutex_init(&pool->mutex, NULL);
+	for (unsigned int c = 0; c < DBF_BUFFER_POOL_NOF_CLASSES; c++)
+	{
+		pool->free_lists[c] = NULL;
+		pool->free_count[c] = 0;
+	}
+	pool->max_free = max_free;
+	pool->cap_bytes = cap_bytes;
+	pool->policy = policy;
+	pool->stats.acquired = 0;
+	pool->stats.hits = 0;
+	pool->stats.misses = 0;
+	pool->stats.dropped = 0;
+	pool->stats.over_cap = 0;
+	pool->stats.current_bytes = 0;
+	pool->stats.peak_bytes = 0;
+	pool->stats.free_bytes = 0;
+}
+
+void DbfBufferPoolDeinit(DbfBufferPool *pool)
+{
+	assert(pool);
+	pthread_mutex_lock(&pool->mutex);
+	for (unsigned int c = 0; c < DBF_BUFFER_POOL_NOF_CLASSES; c++)
+	{
+		while (pool->free_count[c] > 0)
+		{
+			void *buf = take_free(pool, c);
+			ST_FREE_SIZE(buf, class_size(c));
+			add_bytes(pool, -(long)class_size(c));
+		}
+	}
+	if (pool->stats.current_bytes != 0)
+	{
+		printf("DbfBufferPoolDeinit: %zu bytes not released\n", pool->stats.current_bytes);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+unsigned char* DbfBufferPoolAcquire(DbfBufferPool *pool, size_t size, unsigned int *capacity)
+{
+	assert(pool && capacity);
+	const unsigned int c = class_of(size);
+	if (c >= DBF_BUFFER_POOL_NOF_CLASSES)
+	{
+		return NULL;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->stats.acquired++;
+	void *buf = NULL;
+	if (pool->free_count[c] > 0)
+	{
+		buf = take_free(pool, c);
+		pool->stats.hits++;
+	}
+	else
+	{
+		if ((pool->cap_bytes != 0) && (pool->stats.current_bytes + class_size(c) > pool->cap_bytes))
+		{
+			make_room(pool, class_size(c));
+			if (pool->stats.current_bytes + class_size(c) > pool->cap_bytes)
+			{
+				if (pool->policy == DbfBufferPoolDrop)
+				{
+					pool->stats.dropped++;
+					pthread_mutex_unlock(&pool->mutex);
+					return NULL;
+				}
+				pool->stats.over_cap++;
+			}
+		}
+		// The ST_ allocation functions are not thread safe so only used with mutex taken.
+		buf = ST_MALLOC(class_size(c));
+		add_bytes(pool, class_size(c));
+		pool->stats.misses++;
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	*capacity = class_size(c);
+	return buf;
+}
+
+void DbfBufferPoolRelease(DbfBufferPool *pool, unsigned char *buf, unsigned int capacity)
+{
+	assert(pool && buf);
+	const unsigned int c = class_of(capacity);
+	assert((c < DBF_BUFFER_POOL_NOF_CLASSES) && (class_size(c) == capacity));
+
+	pthread_mutex_lock(&pool->mutex);
+	if ((pool->free_count[c] < pool->max_free) &&
+		((pool->cap_bytes == 0) || (pool->stats.current_bytes <= pool->cap_bytes)))
+	{
+		*(void**)buf = pool->free_lists[c];
+		pool->free_lists[c] = buf;
+		pool->free_count[c]++;
+		pool->stats.free_bytes += capacity;
+	}
+	else
+	{
+		ST_FREE_SIZE(buf, capacity);
+		add_bytes(pool, -(long)capacity);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void DbfBufferPoolGetStats(DbfBufferPool *pool, DbfBufferPoolStats *stats)
+{
+	assert(pool && stats);
+	pthread_mutex_lock(&pool->mutex);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,66 @@
+/*
+ * dbf_buffer_pool.h
+ *
+ * A pool of receive buffers in size classes (powers of two), shared by many
+ * DbfReceivers (see DbfReceiverSetBufferPool) or by the channels of a
+ * DbfReceiverBank. With a cap on the total memory.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef DBF_BUFFER_POOL_H_
+#define DBF_BUFFER_POOL_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+// Smallest class is 64 bytes, biggest 32 MB.
+#define DBF_BUFFER_POOL_MIN_SIZE 64
+#define DBF_BUFFER_POOL_NOF_CLASSES 20
+
+// What to do when a buffer is needed but the cap has been reached
+// (after unused buffers have been freed).
+typedef enum
+{
+	DbfBufferPoolDrop, // No buffer is given, the receiver discards the message.
+	DbfBufferPoolAllow, // Allocate anyway, counted in stats over_cap.
+} DbfBufferPoolOverflowPolicy;
+
+typedef struct DbfBufferPoolStats DbfBufferPoolStats;
+struct DbfBufferPoolStats
+{
+	unsigned long acquired;
+	unsigned long hits; // Taken from the free list.
+	unsigned long misses; // A new buffer had to be allocated.
+	unsigned long dropped; // Not given due to the cap.
+	unsigned long over_cap; // Given even if over the cap.
+	size_t current_bytes; // Allocated, in use or not.
+	size_t peak_bytes;
+	size_t free_bytes; // Not in use, kept for reuse.
+};
+
+typedef struct DbfBufferPool DbfBufferPool;
+struct DbfBufferPool
+{
+	pthread_mutex_t mutex;
+	void *free_lists[DBF_BUFFER_POOL_NOF_CLASSES]; // Linked through first bytes of the buffers.
+	unsigned int free_count[DBF_BUFFER_POOL_NOF_CLASSES];
+	unsigned int max_free; // Per class.
+	size_t cap_bytes; // Zero for no cap.
+	DbfBufferPoolOverflowPolicy policy;
+	DbfBufferPoolStats stats;
+};
+
+void DbfBufferPoolInit(DbfBufferPool *pool, size_t cap_bytes, DbfBufferPoolOverflowPolicy policy, unsigned int max_free);
+
+// All buffers must have been released.
+void DbfBufferPoolDeinit(DbfBufferPool *pool);
+
+// Gives a buffer of at least size bytes, capacity tells how big it is.
+// NULL if the cap has been reached (and policy is drop) or size is bigger than the biggest class.
+unsigned char* DbfBufferPoolAcquire(DbfBufferPool *pool, size_t size, unsigned int *capacity);
+void DbfBufferPoolRelease(DbfBufferPool *pool, unsigned char *buf, unsigned int capacity);
+
+void DbfBufferPoolGetStats(DbfBufferPool *pool, DbfBufferPoolStats *stats);
+
+#endif /* DBF_BUFFER_POOL_H_ */
@@ -0,0 +1,242 @@
+/*
+ * dbf_pool.c
+ *
+ * A pool of DbfSerializer objects. At high message rates the
+ * DbfSerializerInit/DbfSerializerDeinit for every message (a malloc and a free)
+ * costs more than the serializing itself. Serializers given back to the pool
+ * keep their buffers so next message gets a buffer that has already grown
+ * to the size typically needed.
+ *
+ * Each thread has a small cache of its own so that most acquire/release
+ * calls do not need to take the mutex. The cache is given back to the
+ * shared list when the thread exits.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "sys_time.h"
+#include "dbf_pool.h"
+
+// A pool serializer also knows its pool, the buffer is grown with the pool mutex taken.
+typedef struct DbfPoolItem DbfPoolItem;
+struct DbfPoolItem
+{
+	DbfSerializer serializer; // Must be first.
+	DbfSerializerPool *pool;
+};
+
+typedef struct DbfPoolThreadCache DbfPoolThreadCache;
+struct DbfPoolThreadCache
+{
+	DbfSerializerPool *pool;
+	unsigned int count;
+	DbfPoolItem *items[DBF_POOL_THREAD_CACHE_SIZE];
+};
+
+#define STAT_ADD(pool, field, n) __atomic_fetch_add(&(pool)->stats.field, (n), __ATOMIC_RELAXED)
+#define STAT_SUB(pool, field, n) __atomic_fetch_sub(&(pool)->stats.field, (n), __ATOMIC_RELAXED)
+
+// Mutex must be taken when calling this.
+static void add_bytes(DbfSerializerPool *pool, long n)
+{
+	pool->stats.current_bytes += n;
+	if (pool->stats.current_bytes > pool->stats.peak_bytes)
+	{
+		pool->stats.peak_bytes = pool->stats.current_bytes;
+	}
+}
+
+// Mutex must be taken when calling this.
+static void free_item(DbfSerializerPool *pool, DbfPoolItem *item)
+{
+	add_bytes(pool, -(long)item->serializer.capacity);
+	DbfSerializerDeinit(&item->serializer);
+	ST_FREE(item);
+}
+
+// Mutex must be taken when calling this.
+static void put_shared(DbfSerializerPool *pool, DbfPoolItem *item)
+{
+	if (pool->free_count < pool->max_free)
+	{
+		pool->free_list[pool->free_count++] = &item->serializer;
+	}
+	else
+	{
+		free_item(pool, item);
+	}
+}
+
+// Called when a thread exits.
+static void thread_cache_destructor(void *ptr)
+{
+	DbfPoolThreadCache *cache = ptr;
+	DbfSerializerPool *pool = cache->pool;
+	pthread_mutex_lock(&pool->mutex);
+	while (cache->count > 0)
+	{
+		put_shared(pool, cache->items[--cache->count]);
+	}
+	ST_FREE(cache);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+// Used instead of ST_RESIZE when a pool serializer needs a bigger buffer.
+// The ST_ allocation functions are not thread safe so only used with mutex taken.
+static unsigned char* resize_locked(DbfSerializer *s, unsigned int new_capacity)
+{
+	DbfPoolItem *item = (DbfPoolItem*)s;
+	DbfSerializerPool *pool = item->pool;
+	pthread_mutex_lock(&pool->mutex);
+	unsigned char *buffer = ST_RESIZE(s->buffer, s->capacity, new_capacity);
+	add_bytes(pool, (long)new_capacity - (long)s->capacity);
+	pthread_mutex_unlock(&pool->mutex);
+	return buffer;
+}
+
+static DbfPoolThreadCache* get_thread_cache(DbfSerializerPool *pool)
+{
+	DbfPoolThreadCache *cache = pthread_getspecific(pool->key);
+	if (cache == NULL)
+	{
+		// The ST_ allocation functions are not thread safe so only used with mutex taken.
+		pthread_mutex_lock(&pool->mutex);
+		cache = ST_MALLOC(sizeof(DbfPoolThreadCache));
+		pthread_mutex_unlock(&pool->mutex);
+		cache->pool = pool;
+		cache->count = 0;
+		pthread_setspecific(pool->key, cache);
+	}
+	return cache;
+}
+
+void DbfSerializerPoolInit(DbfSerializerPool *pool, unsigned int initial_capacity, unsigned int max_free)
+{
+	assert(pool);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_key_create(&pool->key, thread_cache_destructor);
+	pool->max_free = max_free;
+	pool->initial_capacity = initial_capacity;
+	pool->free_count = 0;
+	pool->free_list = NULL;
+	if (max_free > 0)
+	{
+		pool->free_list = ST_MALLOC(max_free * sizeof(DbfSerializer*));
+	}
+	pool->stats.acquired = 0;
+	pool->stats.thread_cache_hits = 0;
+	pool->stats.shared_hits = 0;
+	pool->stats.misses = 0;
+	pool->stats.in_use = 0;
+	pool->stats.current_bytes = 0;
+	pool->stats.peak_bytes = 0;
+}
+
+void DbfSerializerPoolDeinit(DbfSerializerPool *pool)
+{
+	assert(pool);
+	DbfSerializerPoolFlushThread(pool);
+	if (pool->stats.in_use != 0)
+	{
+		printf("DbfSerializerPoolDeinit: %lu serializers not released\n", pool->stats.in_use);
+	}
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->free_count > 0)
+	{
+		free_item(pool, (DbfPoolItem*)pool->free_list[--pool->free_count]);
+	}
+	if (pool->free_list != NULL)
+	{
+		ST_FREE(pool->free_list);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+	pthread_key_delete(pool->key);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+DbfSerializer* DbfSerializerPoolAcquire(DbfSerializerPool *pool)
+{
+	assert(pool);
+	DbfPoolThreadCache *cache = get_thread_cache(pool);
+	STAT_ADD(pool, acquired, 1);
+	STAT_ADD(pool, in_use, 1);
+
+	if (cache->count > 0)
+	{
+		STAT_ADD(pool, thread_cache_hits, 1);
+		return &cache->items[--cache->count]->serializer;
+	}
+
+	pthread_mutex_lock(&pool->mutex);
+	if (pool->free_count > 0)
+	{
+		// Take one and also refill half of the thread cache while we have the mutex.
+		DbfPoolItem *item = (DbfPoolItem*)pool->free_list[--pool->free_count];
+		while ((pool->free_count > 0) && (cache->count < DBF_POOL_THREAD_CACHE_SIZE/2))
+		{
+			cache->items[cache->count++] = (DbfPoolItem*)pool->free_list[--pool->free_count];
+		}
+		pthread_mutex_unlock(&pool->mutex);
+		STAT_ADD(pool, shared_hits, 1);
+		return &item->serializer;
+	}
+
+	DbfPoolItem *item = ST_MALLOC(sizeof(DbfPoolItem));
+	DbfSerializerInitReserve(&item->serializer, pool->initial_capacity);
+	item->serializer.resize = resize_locked;
+	item->pool = pool;
+	add_bytes(pool, item->serializer.capacity);
+	pthread_mutex_unlock(&pool->mutex);
+	STAT_ADD(pool, misses, 1);
+	return &item->serializer;
+}
+
+void DbfSerializerPoolRelease(DbfSerializerPool *pool, DbfSerializer *s)
+{
+	DbfPoolItem *item = (DbfPoolItem*)s;
+	assert(pool && s && !s->external_buffer && (item->pool == pool));
+	DbfPoolThreadCache *cache = get_thread_cache(pool);
+	STAT_SUB(pool, in_use, 1);
+
+	// Next user shall get it same as after DbfSerializerInit (binary mode).
+	s->encoderState = DBF_ENCODER_IDLE;
+	DbfSerializerReset(s);
+
+	if (cache->count < DBF_POOL_THREAD_CACHE_SIZE)
+	{
+		cache->items[cache->count++] = item;
+		return;
+	}
+
+	// Thread cache is full, give half of it and this one to the shared list.
+	pthread_mutex_lock(&pool->mutex);
+	while (cache->count > DBF_POOL_THREAD_CACHE_SIZE/2)
+	{
+		put_shared(pool, cache->items[--cache->count]);
+	}
+	put_shared(pool, item);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void DbfSerializerPoolFlushThread(DbfSerializerPool *pool)
+{
+	assert(pool);
+	DbfPoolThreadCache *cache = pthread_getspecific(pool->key);
+	if (cache != NULL)
+	{
+		pthread_setspecific(pool->key, NULL);
+		thread_cache_destructor(cache);
+	}
+}
+
+void DbfSerializerPoolGetStats(DbfSerializerPool *pool, DbfSerializerPoolStats *stats)
+{
+	assert(pool && stats);
+	pthread_mutex_lock(&pool->mutex);
+	*stats = pool->stats;
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,66 @@
+/*
+ * dbf_pool.h
+ *
+ * A pool of DbfSerializer objects so that buffers can be reused
+ * instead of being allocated and freed for every message.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef DBF_POOL_H_
+#define DBF_POOL_H_
+
+#include <stddef.h>
+#include <pthread.h>
+
+#include "dbf.h"
+
+// Number of serializers each thread can keep for itself
+// before some are given back to the list shared by all threads.
+#define DBF_POOL_THREAD_CACHE_SIZE 16
+
+typedef struct DbfSerializerPoolStats DbfSerializerPoolStats;
+struct DbfSerializerPoolStats
+{
+	unsigned long acquired;
+	unsigned long thread_cache_hits; // Taken from the callers own thread cache.
+	unsigned long shared_hits; // Taken from the list shared by all threads.
+	unsigned long misses; // A new serializer had to be allocated.
+	unsigned long in_use;
+	size_t current_bytes; // Buffer memory owned by the pool (in use or not).
+	size_t peak_bytes;
+};
+
+typedef struct DbfSerializerPool DbfSerializerPool;
+struct DbfSerializerPool
+{
+	pthread_mutex_t mutex;
+	pthread_key_t key; // For the per thread caches.
+	DbfSerializer **free_list;
+	unsigned int free_count;
+	unsigned int max_free;
+	unsigned int initial_capacity;
+	DbfSerializerPoolStats stats;
+};
+
+// initial_capacity is the buffer size for new serializers. They still grow if needed,
+// that is done with the pool mutex taken (the ST_ allocation functions are not thread safe).
+// max_free is the number of unused serializers to keep in the shared list, more are freed.
+void DbfSerializerPoolInit(DbfSerializerPool *pool, unsigned int initial_capacity, unsigned int max_free);
+
+// All serializers must have been released and all other threads
+// that used the pool must have exited or called DbfSerializerPoolFlushThread.
+void DbfSerializerPoolDeinit(DbfSerializerPool *pool);
+
+// Gives a serializer ready to write a binary message, same as after DbfSerializerInit.
+// Do not call DbfSerializerDeinit on it, give it back with DbfSerializerPoolRelease.
+DbfSerializer* DbfSerializerPoolAcquire(DbfSerializerPool *pool);
+void DbfSerializerPoolRelease(DbfSerializerPool *pool, DbfSerializer *s);
+
+// Give the serializers cached by the calling thread back to the shared list.
+// Done automatically when a thread exits.
+void DbfSerializerPoolFlushThread(DbfSerializerPool *pool);
+
+void DbfSerializerPoolGetStats(DbfSerializerPool *pool, DbfSerializerPoolStats *stats);
+
+#endif /* DBF_POOL_H_ */
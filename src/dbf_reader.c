@@ -0,0 +1,259 @@
+/*
+ * dbf_reader.c
+ *
+ * Reads from many channels with epoll. Each ready channel is read once per
+ * wakeup (up to DBF_READER_READ_SIZE bytes, so one busy channel can not starve
+ * the others) and the bytes are framed with DbfReceiverProcessBuffer.
+ * One timerfd advances a timer wheel that has the timeouts of all channels,
+ * so only channels in the middle of a message cost anything. All receivers
+ * use a cached clock that is updated once per wakeup, so there are no time
+ * syscalls per byte or per message.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "sys_time.h"
+#include "dbf_reader.h"
+
+#define DBF_READER_MAX_EVENTS 64
+
+int DbfReaderInit(DbfReader *reader, DbfReaderMessageCallback onMessage, DbfReaderClosedCallback onClosed, void *user)
+{
+	assert(reader && onMessage);
+	reader->channels = NULL;
+	reader->nofChannels = 0;
+	reader->channelsCapacity = 0;
+	reader->removed = NULL;
+	reader->polling = 0;
+	reader->readBuf = NULL;
+	reader->onMessage = onMessage;
+	reader->onClosed = onClosed;
+	reader->user = user;
+	DbfClockInitCached(&reader->clock);
+	DbfTimerWheelInit(&reader->wheel, DbfClockGetMs(&reader->clock));
+
+	reader->epollFd = epoll_create1(EPOLL_CLOEXEC);
+	if (reader->epollFd < 0)
+	{
+		return -1;
+	}
+
+	reader->timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (reader->timerFd < 0)
+	{
+		close(reader->epollFd);
+		return -1;
+	}
+	struct itimerspec t;
+	t.it_interval.tv_sec = DBF_READER_TICK_MS / 1000;
+	t.it_interval.tv_nsec = (DBF_READER_TICK_MS % 1000) * 1000000L;
+	t.it_value = t.it_interval;
+	timerfd_settime(reader->timerFd, 0, &t, NULL);
+
+	// The timer is the only one registered with a NULL pointer.
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(reader->epollFd, EPOLL_CTL_ADD, reader->timerFd, &ev) != 0)
+	{
+		close(reader->timerFd);
+		close(reader->epollFd);
+		return -1;
+	}
+
+	reader->readBuf = ST_MALLOC(DBF_READER_READ_SIZE);
+	return 0;
+}
+
+static void free_channel(DbfReaderChannel *channel)
+{
+	DbfReceiverDeinit(&channel->receiver);
+	ST_FREE(channel);
+}
+
+// Channels removed during DbfReaderPoll are kept until it is done with them.
+static void free_removed(DbfReader *reader)
+{
+	while (reader->removed != NULL)
+	{
+		DbfReaderChannel *channel = reader->removed;
+		reader->removed = channel->nextRemoved;
+		free_channel(channel);
+	}
+}
+
+void DbfReaderDeinit(DbfReader *reader)
+{
+	assert(reader && !reader->polling);
+	while (reader->nofChannels > 0)
+	{
+		DbfReaderRemove(reader, reader->channels[reader->nofChannels - 1]);
+	}
+	if (reader->channels != NULL)
+	{
+		ST_FREE_SIZE(reader->channels, reader->channelsCapacity * sizeof(DbfReaderChannel*));
+	}
+	if (reader->readBuf != NULL)
+	{
+		ST_FREE_SIZE(reader->readBuf, DBF_READER_READ_SIZE);
+	}
+	close(reader->timerFd);
+	close(reader->epollFd);
+	reader->channelsCapacity = 0;
+}
+
+DbfReaderChannel* DbfReaderAdd(DbfReader *reader, int fd, void *user)
+{
+	assert(reader && (fd >= 0));
+
+	const int flags = fcntl(fd, F_GETFL, 0);
+	if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0))
+	{
+		return NULL;
+	}
+
+	DbfReaderChannel *channel = ST_MALLOC(sizeof(DbfReaderChannel));
+	DbfReceiverInit(&channel->receiver);
+	DbfReceiverSetClock(&channel->receiver, &reader->clock);
+	DbfReceiverSetTimerWheel(&channel->receiver, &reader->wheel);
+	channel->fd = fd;
+	channel->user = user;
+	channel->reader = reader;
+	channel->removed = 0;
+	channel->nextRemoved = NULL;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.ptr = channel;
+	if (epoll_ctl(reader->epollFd, EPOLL_CTL_ADD, fd, &ev) != 0)
+	{
+		free_channel(channel);
+		return NULL;
+	}
+
+	if (reader->nofChannels == reader->channelsCapacity)
+	{
+		const unsigned int c = (reader->channelsCapacity == 0) ? 16 : reader->channelsCapacity * 2;
+		if (reader->channels == NULL)
+		{
+			reader->channels = ST_MALLOC(c * sizeof(DbfReaderChannel*));
+		}
+		else
+		{
+			reader->channels = ST_RESIZE(reader->channels, reader->channelsCapacity * sizeof(DbfReaderChannel*), c * sizeof(DbfReaderChannel*));
+		}
+		reader->channelsCapacity = c;
+	}
+	channel->index = reader->nofChannels;
+	reader->channels[reader->nofChannels++] = channel;
+	return channel;
+}
+
+void DbfReaderRemove(DbfReader *reader, DbfReaderChannel *channel)
+{
+	assert(reader && channel && (channel->reader == reader));
+	if (channel->removed)
+	{
+		return;
+	}
+	channel->removed = 1;
+	epoll_ctl(reader->epollFd, EPOLL_CTL_DEL, channel->fd, NULL);
+
+	// Move the last one into its place.
+	DbfReaderChannel *last = reader->channels[--reader->nofChannels];
+	reader->channels[channel->index] = last;
+	last->index = channel->index;
+
+	if (reader->polling)
+	{
+		// There may be more events for it, free it when DbfReaderPoll is done.
+		channel->nextRemoved = reader->removed;
+		reader->removed = channel;
+	}
+	else
+	{
+		free_channel(channel);
+	}
+}
+
+static void on_message(void *user, DbfReceiver *receiver)
+{
+	(void)receiver;
+	DbfReaderChannel *channel = user;
+	if (!channel->removed)
+	{
+		channel->reader->onMessage(channel->reader->user, channel);
+	}
+}
+
+static void on_timer(DbfReader *reader)
+{
+	uint64_t expirations;
+	if (read(reader->timerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+	{
+		return;
+	}
+	DbfTimerWheelAdvance(&reader->wheel, DbfClockGetMs(&reader->clock));
+}
+
+// Returns number of messages.
+static int read_channel(DbfReader *reader, DbfReaderChannel *channel)
+{
+	const ssize_t n = read(channel->fd, reader->readBuf, DBF_READER_READ_SIZE);
+	if (n > 0)
+	{
+		return DbfReceiverProcessBuffer(&channel->receiver, reader->readBuf, n, on_message, channel);
+	}
+	if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+	{
+		return 0;
+	}
+
+	// End of file or error.
+	if (reader->onClosed != NULL)
+	{
+		reader->onClosed(reader->user, channel);
+	}
+	DbfReaderRemove(reader, channel);
+	return 0;
+}
+
+int DbfReaderPoll(DbfReader *reader, int timeoutMs)
+{
+	assert(reader && !reader->polling);
+	struct epoll_event events[DBF_READER_MAX_EVENTS];
+	const int nofEvents = epoll_wait(reader->epollFd, events, DBF_READER_MAX_EVENTS, timeoutMs);
+	if (nofEvents < 0)
+	{
+		return (errno == EINTR) ? 0 : -1;
+	}
+
+	DbfClockUpdate(&reader->clock);
+	reader->polling = 1;
+	int nofMessages = 0;
+	for (int i = 0; i < nofEvents; i++)
+	{
+		DbfReaderChannel *channel = events[i].data.ptr;
+		if (channel == NULL)
+		{
+			on_timer(reader);
+		}
+		else if (!channel->removed)
+		{
+			nofMessages += read_channel(reader, channel);
+		}
+	}
+	reader->polling = 0;
+	free_removed(reader);
+	return nofMessages;
+}
@@ -0,0 +1,75 @@
+/*
+ * dbf_reader.h
+ *
+ * Reads DBF (and text) messages from many file descriptors (serial ports,
+ * ptys, pipes, sockets) with epoll. Each channel has its own DbfReceiver,
+ * timeouts of all channels are driven by one shared timer and timer wheel. Linux only.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef DBF_READER_H_
+#define DBF_READER_H_
+
+#include "dbf.h"
+
+// Bytes read from a channel at a time.
+#define DBF_READER_READ_SIZE 65536
+
+// How often the timer wheel with the receiver timeouts is advanced.
+#define DBF_READER_TICK_MS 100
+
+typedef struct DbfReader DbfReader;
+typedef struct DbfReaderChannel DbfReaderChannel;
+
+// A message has been received on a channel. It is in channel->receiver until the callback returns.
+typedef void (*DbfReaderMessageCallback)(void *user, DbfReaderChannel *channel);
+
+// Channel got end of file or a read error. It is removed from the reader when the
+// callback returns and freed when DbfReaderPoll is done. The file descriptor is not closed.
+typedef void (*DbfReaderClosedCallback)(void *user, DbfReaderChannel *channel);
+
+struct DbfReaderChannel
+{
+	DbfReceiver receiver;
+	int fd;
+	void *user; // For the caller.
+	DbfReader *reader;
+	unsigned int index; // In reader->channels.
+	unsigned char removed;
+	DbfReaderChannel *nextRemoved;
+};
+
+struct DbfReader
+{
+	int epollFd;
+	int timerFd;
+	DbfClock clock; // Updated once per wakeup, used by all receivers.
+	DbfTimerWheel wheel;
+	DbfReaderChannel **channels;
+	unsigned int nofChannels;
+	unsigned int channelsCapacity;
+	DbfReaderChannel *removed; // Channels removed while polling, freed when done.
+	unsigned char polling;
+	unsigned char *readBuf;
+	DbfReaderMessageCallback onMessage;
+	DbfReaderClosedCallback onClosed; // Can be NULL.
+	void *user;
+};
+
+// Returns 0 if OK, -1 if epoll or timer could not be created (see errno).
+int DbfReaderInit(DbfReader *reader, DbfReaderMessageCallback onMessage, DbfReaderClosedCallback onClosed, void *user);
+void DbfReaderDeinit(DbfReader *reader);
+
+// The file descriptor is set non blocking. Returns NULL if it could not be added.
+// Use DbfReceiverSetMaxMsgSize on channel->receiver to receive big messages.
+DbfReaderChannel* DbfReaderAdd(DbfReader *reader, int fd, void *user);
+
+// The file descriptor is not closed. Can be called from the callbacks.
+void DbfReaderRemove(DbfReader *reader, DbfReaderChannel *channel);
+
+// Waits up to timeoutMs (-1 for no limit) for input, then reads from all channels that
+// have some and gives the messages to the callback. Returns number of messages, -1 on error.
+int DbfReaderPoll(DbfReader *reader, int timeoutMs);
+
+#endif /* DBF_READER_H_ */
@@ -0,0 +1,184 @@
+/*
+ * dbf_timer.c
+ *
+ * Timers less than 64 ms away are in level 0, one slot per ms. Timers further
+ * away are in a higher level where each slot covers 64 times more. When level 0
+ * has gone one round the next slot of level 1 is moved down, and so on.
+ * See also "Hashed and Hierarchical Timing Wheels", Varghese and Lauck.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stddef.h>
+#include <assert.h>
+
+#include "dbf_timer.h"
+
+#define SLOT_MASK (DBF_TIMER_SLOTS - 1)
+#define MAX_DELTA ((1ULL << (DBF_TIMER_SLOT_BITS * DBF_TIMER_LEVELS)) - 1)
+
+static void list_init(DbfTimer *head)
+{
+	head->next = head;
+	head->prev = head;
+}
+
+static void list_add(DbfTimer *head, DbfTimer *t)
+{
+	t->next = head;
+	t->prev = head->prev;
+	head->prev->next = t;
+	head->prev = t;
+}
+
+static void list_remove(DbfTimer *t)
+{
+	t->prev->next = t->next;
+	t->next->prev = t->prev;
+	t->next = NULL;
+	t->prev = NULL;
+}
+
+// Put timer in the slot for its expire time (but not before earliestMs),
+// relative to current time of wheel.
+static void add_timer(DbfTimerWheel *w, DbfTimer *t, uint64_t earliestMs)
+{
+	uint64_t e = t->expiresMs;
+	if (e < earliestMs)
+	{
+		e = earliestMs;
+	}
+	else if (e - w->nowMs > MAX_DELTA)
+	{
+		e = w->nowMs + MAX_DELTA;
+	}
+	const uint64_t delta = e - w->nowMs;
+
+	unsigned int level = 0;
+	while ((level < DBF_TIMER_LEVELS - 1) && (delta >= (1ULL << (DBF_TIMER_SLOT_BITS * (level + 1)))))
+	{
+		level++;
+	}
+	list_add(&w->slots[level][(e >> (DBF_TIMER_SLOT_BITS * level)) & SLOT_MASK], t);
+}
+
+// Move the timers in current slot of a level to lower levels.
+// Returns index of that slot, when it is zero next level shall also be cascaded.
+static unsigned int cascade(DbfTimerWheel *w, unsigned int level)
+{
+	const unsigned int idx = (w->nowMs >> (DBF_TIMER_SLOT_BITS * level)) & SLOT_MASK;
+	DbfTimer *head = &w->slots[level][idx];
+	DbfTimer list;
+	if (head->next == head)
+	{
+		return idx;
+	}
+	// Take the whole list before adding, timers could come back to same slot.
+	list.next = head->next;
+	list.prev = head->prev;
+	list.next->prev = &list;
+	list.prev->next = &list;
+	list_init(head);
+	while (list.next != &list)
+	{
+		DbfTimer *t = list.next;
+		list_remove(t);
+		add_timer(w, t, w->nowMs);
+	}
+	return idx;
+}
+
+void DbfTimerWheelInit(DbfTimerWheel *w, uint64_t nowMs)
+{
+	assert(w);
+	w->nowMs = nowMs;
+	w->nofTimers = 0;
+	for (unsigned int l = 0; l < DBF_TIMER_LEVELS; l++)
+	{
+		for (unsigned int i = 0; i < DBF_TIMER_SLOTS; i++)
+		{
+			list_init(&w->slots[l][i]);
+		}
+	}
+}
+
+unsigned int DbfTimerWheelAdvance(DbfTimerWheel *w, uint64_t nowMs)
+{
+	assert(w);
+	unsigned int n = 0;
+	while (w->nowMs < nowMs)
+	{
+		if (w->nofTimers == 0)
+		{
+			// Nothing to do, just catch up.
+			w->nowMs = nowMs;
+			break;
+		}
+		w->nowMs++;
+		const unsigned int idx = w->nowMs & SLOT_MASK;
+		if (idx == 0)
+		{
+			unsigned int level = 1;
+			while ((level < DBF_TIMER_LEVELS) && (cascade(w, level) == 0))
+			{
+				level++;
+			}
+		}
+		DbfTimer *head = &w->slots[0][idx];
+		while (head->next != head)
+		{
+			DbfTimer *t = head->next;
+			list_remove(t);
+			if (t->expiresMs > w->nowMs)
+			{
+				// Was further away than the wheel covers.
+				add_timer(w, t, w->nowMs);
+				continue;
+			}
+			w->nofTimers--;
+			n++;
+			t->callback(t);
+		}
+	}
+	return n;
+}
+
+void DbfTimerInit(DbfTimer *t, DbfTimerCallback callback)
+{
+	assert(t && callback);
+	t->next = NULL;
+	t->prev = NULL;
+	t->expiresMs = 0;
+	t->callback = callback;
+}
+
+void DbfTimerStart(DbfTimerWheel *w, DbfTimer *t, uint64_t expiresMs)
+{
+	assert(w && t);
+	if (t->next != NULL)
+	{
+		list_remove(t);
+	}
+	else
+	{
+		w->nofTimers++;
+	}
+	t->expiresMs = expiresMs;
+	// Slot for current time has already been run, so expired timers run at next ms.
+	add_timer(w, t, w->nowMs + 1);
+}
+
+void DbfTimerStop(DbfTimerWheel *w, DbfTimer *t)
+{
+	assert(w && t);
+	if (t->next != NULL)
+	{
+		list_remove(t);
+		w->nofTimers--;
+	}
+}
+
+int DbfTimerIsRunning(const DbfTimer *t)
+{
+	return (t->next != NULL);
+}
@@ -0,0 +1,54 @@
+/*
+ * dbf_timer.h
+ *
+ * A hierarchical timer wheel. Starting, stopping and expiring a timer
+ * is O(1) (amortized) no matter how many timers there are, so it can
+ * drive timeouts of a very large number of receivers.
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#ifndef DBF_TIMER_H_
+#define DBF_TIMER_H_
+
+#include <stdint.h>
+
+// 4 levels of 64 slots with 1 ms resolution covers 2^24 ms (about 4.6 hours).
+// Timers further away than that are put as far as possible and moved again when reached.
+#define DBF_TIMER_SLOT_BITS 6
+#define DBF_TIMER_SLOTS (1 << DBF_TIMER_SLOT_BITS)
+#define DBF_TIMER_LEVELS 4
+
+typedef struct DbfTimer DbfTimer;
+typedef void (*DbfTimerCallback)(DbfTimer *timer);
+
+struct DbfTimer
+{
+	DbfTimer *next; // NULL if timer is not running.
+	DbfTimer *prev;
+	uint64_t expiresMs;
+	DbfTimerCallback callback;
+};
+
+typedef struct DbfTimerWheel DbfTimerWheel;
+struct DbfTimerWheel
+{
+	uint64_t nowMs; // Timers up to this time have been run.
+	unsigned int nofTimers;
+	DbfTimer slots[DBF_TIMER_LEVELS][DBF_TIMER_SLOTS]; // List heads.
+};
+
+void DbfTimerWheelInit(DbfTimerWheel *wheel, uint64_t nowMs);
+
+// Runs callbacks of all timers that expire at or before nowMs.
+// A callback may start or stop timers. Returns number of timers run.
+unsigned int DbfTimerWheelAdvance(DbfTimerWheel *wheel, uint64_t nowMs);
+
+void DbfTimerInit(DbfTimer *timer, DbfTimerCallback callback);
+
+// Starts (or restarts if running) the timer to expire at expiresMs.
+void DbfTimerStart(DbfTimerWheel *wheel, DbfTimer *timer, uint64_t expiresMs);
+void DbfTimerStop(DbfTimerWheel *wheel, DbfTimer *timer);
+int DbfTimerIsRunning(const DbfTimer *timer);
+
+#endif /* DBF_TIMER_H_ */
@@ -0,0 +1,279 @@
+/*
+ * test_command.c
+ *
+ * DbfCommandMatch on messages that begin with the command word, with a longer word,
+ * a shorter one or another field after it. Many random command words in tables of
+ * a few sizes (so that words share slots) must all be found, words not added must
+ * not, adding a word twice or to a full table must fail. DbfUnserializerReadCommand
+ * must only take the command word when it is the next field.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_command.c -lpthread -o test_command && ./test_command
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+#define MAX_COMMANDS 300
+#define MAX_WORD 12
+
+static char words[MAX_COMMANDS * 2][MAX_WORD + 1];
+static DbfCommand commands[MAX_COMMANDS * 2];
+
+// Word followed by a number (or a string) in a message.
+static void write_command(DbfSerializer *s, const char *word, int string)
+{
+	DbfSerializerInit(s);
+	DbfSerializerWriteWord(s, word);
+	if (string)
+	{
+		DbfSerializerWriteString(s, "Sarg");
+	}
+	else
+	{
+		DbfSerializerWriteInt32(s, 1000);
+	}
+	DbfSerializerWriteCrc(s);
+}
+
+static void test_match(void)
+{
+	DbfCommand c;
+	DbfSerializer s;
+	CHECK(DbfCommandInit(&c, "start", 7) == 0);
+	CHECK(c.id == 7);
+
+	write_command(&s, "start", 0);
+	CHECK(DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+	CHECK(!DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), c.len - 1));
+	DbfSerializerDeinit(&s);
+
+	write_command(&s, "start", 1);
+	CHECK(DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+	DbfSerializerDeinit(&s);
+
+	// The word only, nothing after it.
+	DbfSerializerInit(&s);
+	DbfSerializerWriteWord(&s, "start");
+	DbfSerializerFinalize(&s);
+	CHECK(DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+	DbfSerializerDeinit(&s);
+
+	// Begins with the command but the word is longer.
+	write_command(&s, "starts", 0);
+	CHECK(!DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+	DbfSerializerDeinit(&s);
+
+	write_command(&s, "star", 0);
+	CHECK(!DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+	DbfSerializerDeinit(&s);
+
+	// A string is not the same as a word.
+	DbfSerializerInit(&s);
+	DbfSerializerWriteString(&s, "start");
+	DbfSerializerWriteCrc(&s);
+	CHECK(!DbfCommandMatch(&c, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+	DbfSerializerDeinit(&s);
+
+	CHECK(!DbfCommandMatch(&c, NULL, 0));
+
+	// Too long to be a command.
+	char longWord[DBF_COMMAND_MAX_SIZE + 8];
+	memset(longWord, 'x', sizeof(longWord) - 1);
+	for (unsigned int i = 0; i < sizeof(longWord) - 1; i += 2)
+	{
+		longWord[i] = 'y';
+	}
+	longWord[sizeof(longWord) - 1] = 0;
+	CHECK(DbfCommandInit(&c, longWord, 0) == -1);
+}
+
+// Random words, no two the same. No '@', its code is 0, same as the code before the
+// first in a message, so the serializer would give a repeat code for it.
+static void random_words(unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i++)
+	{
+		int unique;
+		do
+		{
+			const unsigned int len = 1 + rnd(rnd(2) ? 3 : MAX_WORD);
+			for (unsigned int k = 0; k < len; k++)
+			{
+				const char ch = rnd(4) ? 'a' + rnd(26) : '!' + rnd('?' - '!');
+				words[i][k] = (ch == '\"') ? 'q' : ch; // Not part of a word.
+			}
+			words[i][len] = 0;
+			unique = 1;
+			for (unsigned int k = 0; (k < i) && unique; k++)
+			{
+				unique = strcmp(words[i], words[k]) != 0;
+			}
+		} while (!unique);
+	}
+}
+
+static void test_table(unsigned int n)
+{
+	// Half of the words are added, the other half are not.
+	random_words(n * 2);
+	DbfCommandTable t;
+	DbfCommandTableInit(&t, n);
+	for (unsigned int i = 0; i < n * 2; i++)
+	{
+		CHECK(DbfCommandInit(&commands[i], words[i], i) == 0);
+	}
+	for (unsigned int i = 0; i < n; i++)
+	{
+		CHECK(DbfCommandTableAdd(&t, &commands[i]) == 0);
+	}
+	CHECK(t.nofCommands == n);
+
+	// Full, and same word again (a copy of it, not the same command).
+	CHECK(DbfCommandTableAdd(&t, &commands[n]) == -1);
+	DbfCommand again = commands[rnd(n)];
+	CHECK(DbfCommandTableAdd(&t, &again) == -1);
+	CHECK(t.nofCommands == n);
+
+	for (unsigned int i = 0; i < n * 2; i++)
+	{
+		DbfSerializer s;
+		write_command(&s, words[i], rnd(2));
+		const DbfCommand *c = DbfCommandTableLookup(&t, DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s));
+		CHECK(c == ((i < n) ? &commands[i] : NULL));
+		CHECK(DbfCommandMatch(&commands[i], DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgLen(&s)));
+		DbfSerializerDeinit(&s);
+	}
+	CHECK(DbfCommandTableLookup(&t, NULL, 0) == NULL);
+	DbfCommandTableDeinit(&t);
+
+	// Duplicate when not full.
+	DbfCommandTableInit(&t, n + 1);
+	for (unsigned int i = 0; i < n; i++)
+	{
+		CHECK(DbfCommandTableAdd(&t, &commands[i]) == 0);
+	}
+	CHECK(DbfCommandTableAdd(&t, &again) == -1);
+	CHECK(DbfCommandTableAdd(&t, &commands[n]) == 0);
+	CHECK(DbfCommandTableLookup(&t, commands[n].bytes, commands[n].len) == &commands[n]);
+	DbfCommandTableDeinit(&t);
+}
+
+static void test_read_command(void)
+{
+	DbfCommand go;
+	DbfCommand stop;
+	DbfCommandTable t;
+	DbfCommandInit(&go, "go", 1);
+	DbfCommandInit(&stop, "stop", 2);
+	DbfCommandTableInit(&t, 2);
+	DbfCommandTableAdd(&t, &go);
+	DbfCommandTableAdd(&t, &stop);
+
+	char buf[32];
+	DbfSerializer s;
+	DbfUnserializer u;
+
+	// The command and then its arguments.
+	DbfSerializerInit(&s);
+	DbfSerializerWriteWord(&s, "stop");
+	DbfSerializerWriteInt32(&s, 1000);
+	DbfSerializerWriteString(&s, "Sarg");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == &stop);
+	CHECK(DbfUnserializerReadInt64(&u) == 1000);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == NULL);
+	CHECK(DbfUnserializerRead(&u, buf, sizeof(buf)) == 6);
+	CHECK(strcmp(buf, "\"Sarg\"") == 0);
+	CHECK(DbfUnserializerReadIsNextEnd(&u));
+	DbfSerializerDeinit(&s);
+
+	// Only the command.
+	DbfSerializerInit(&s);
+	DbfSerializerWriteWord(&s, "go");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == &go);
+	CHECK(DbfUnserializerReadIsNextEnd(&u));
+	DbfSerializerDeinit(&s);
+
+	// Two command words, the message begins with the first, so the second one is not
+	// found after the first has been taken (it is not the beginning of the message).
+	DbfSerializerInit(&s);
+	DbfSerializerWriteWord(&s, "go");
+	DbfSerializerWriteWord(&s, "stop");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == &go);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == NULL);
+	CHECK(DbfUnserializerRead(&u, buf, sizeof(buf)) == 4);
+	CHECK(strcmp(buf, "stop") == 0);
+	CHECK(DbfUnserializerReadIsNextEnd(&u));
+
+	// The first word read some other way, the command is then not the next field.
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerRead(&u, buf, sizeof(buf)) == 2);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == NULL);
+	CHECK(DbfUnserializerRead(&u, buf, sizeof(buf)) == 4);
+	CHECK(strcmp(buf, "stop") == 0);
+	DbfSerializerDeinit(&s);
+
+	// Not a command, or a number first. Nothing is taken.
+	DbfSerializerInit(&s);
+	DbfSerializerWriteWord(&s, "gone");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == NULL);
+	CHECK(DbfUnserializerRead(&u, buf, sizeof(buf)) == 4);
+	CHECK(strcmp(buf, "gone") == 0);
+	DbfSerializerDeinit(&s);
+
+	DbfSerializerInit(&s);
+	DbfSerializerWriteInt32(&s, 1000);
+	DbfSerializerWriteWord(&s, "go");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == NULL);
+	CHECK(DbfUnserializerReadInt64(&u) == 1000);
+	CHECK(DbfUnserializerReadCommand(&u, &t) == NULL);
+	CHECK(DbfUnserializerRead(&u, buf, sizeof(buf)) == 2);
+	CHECK(strcmp(buf, "go") == 0);
+	DbfSerializerDeinit(&s);
+
+	DbfCommandTableDeinit(&t);
+}
+
+int main(void)
+{
+	st_init();
+	test_match();
+	test_read_command();
+	for (unsigned int round = 0; (round < 200) && (failures == 0); round++)
+	{
+		// Small tables often have words in same slot, big ones always do.
+		static const unsigned int sizes[] = {1, 2, 7, 8, 9, 30, MAX_COMMANDS};
+		test_table(sizes[round % (sizeof(sizes) / sizeof(sizes[0]))]);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * test_crc32c.c
+ *
+ * Tests of CRC32C: the check value, running checksums in random pieces, and
+ * messages written with DbfSerializerWriteCrc32c. Those must read back as written,
+ * any corrupted byte must give DBF_BAD_CRC, and messages with the usual CRC or
+ * without a CRC must still read as before.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_crc32c.c -lpthread -o test_crc32c && ./test_crc32c
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "crc32c.h"
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+// Check value of CRC32C, and running checksums (of all lengths and alignments,
+// so both the wide and the byte at a time parts are used) same as the whole.
+static void test_checksum(void)
+{
+	static unsigned char buf[5000];
+	CHECK(crc32c_calculate((const unsigned char*)"123456789", 9) == 0xE3069283UL);
+	CHECK(crc32c_calculate(buf, 0) == 0);
+	for (unsigned int i = 0; i < sizeof(buf); i++)
+	{
+		buf[i] = rnd(256);
+	}
+	for (unsigned int round = 0; round < 2000; round++)
+	{
+		const unsigned int begin = rnd(64);
+		const unsigned int size = rnd((round < 1000) ? 100 : sizeof(buf) - begin);
+		const uint32_t whole = crc32c_calculate(buf + begin, size);
+		uint32_t crc = crc32c_init();
+		unsigned int pos = 0;
+		while (pos < size)
+		{
+			unsigned int n = rnd(40);
+			if (n > size - pos)
+			{
+				n = size - pos;
+			}
+			crc = crc32c_update(crc, buf + begin + pos, n);
+			pos += n;
+		}
+		CHECK(crc32c_final(crc) == whole);
+	}
+}
+
+static void write_fields(DbfSerializer *s, unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i++)
+	{
+		switch (i % 4)
+		{
+			case 0: DbfSerializerWriteInt32(s, 1000 + i); break;
+			case 1: DbfSerializerWriteString(s, "Some text"); break;
+			case 2: DbfSerializerWriteInt64(s, -123456789012LL); break;
+			default: DbfSerializerWriteWord(s, "Word"); break;
+		}
+	}
+}
+
+static void check_fields(DbfUnserializer *u, unsigned int n)
+{
+	char buf[64];
+	for (unsigned int i = 0; i < n; i++)
+	{
+		switch (i % 4)
+		{
+			case 0: CHECK(DbfUnserializerReadInt32(u) == (int32_t)(1000 + i)); break;
+			case 1:
+				CHECK(DbfUnserializerRead(u, buf, sizeof(buf)) == 11);
+				CHECK(strcmp(buf, "\"Some text\"") == 0);
+				break;
+			case 2: CHECK(DbfUnserializerReadInt64(u) == -123456789012LL); break;
+			default:
+				CHECK(DbfUnserializerRead(u, buf, sizeof(buf)) == 4);
+				CHECK(strcmp(buf, "Word") == 0);
+				break;
+		}
+	}
+	// The CRC32C format code is not left in the message.
+	CHECK(DbfUnserializerReadIsNextEnd(u));
+}
+
+// Messages with CRC32C read back, with any byte before the CRC code corrupted they do not.
+static void test_message(unsigned int nofFields)
+{
+	static unsigned char msg[1000];
+	DbfSerializer s;
+	DbfSerializer plain;
+	DbfUnserializer u;
+
+	DbfSerializerInit(&s);
+	write_fields(&s, nofFields);
+	DbfSerializerWriteCrc32c(&s);
+	const unsigned int len = DbfSerializerGetMsgLen(&s);
+	memcpy(msg, DbfSerializerGetMsgPtr(&s), len);
+	CHECK(DbfUnserializerInitTakeCrc(&u, msg, len) == DBF_OK_CRC);
+	check_fields(&u, nofFields);
+
+	// Same message without CRC, to know where the CRC32C format code is.
+	DbfSerializerInit(&plain);
+	write_fields(&plain, nofFields);
+	DbfSerializerFinalize(&plain);
+	const unsigned int payloadLen = DbfSerializerGetMsgLen(&plain);
+	CHECK(memcmp(msg, DbfSerializerGetMsgPtr(&plain), payloadLen) == 0);
+	CHECK(msg[payloadLen] == DBF_FMTCRC_CODEID + DBF_CRC32C_CODE);
+
+	// Without a CRC, such a message is not taken by DbfUnserializerInitTakeCrc.
+	CHECK(DbfUnserializerInitTakeCrc(&u, DbfSerializerGetMsgPtr(&plain), payloadLen) == DBF_NO_CRC);
+	CHECK(DbfUnserializerReadIsNextEnd(&u));
+	DbfUnserializerInitNoCRC(&u, DbfSerializerGetMsgPtr(&plain), payloadLen);
+	check_fields(&u, nofFields);
+
+	// Corrupted, the format code of the CRC32C included.
+	for (unsigned int i = 0; i <= payloadLen; i++)
+	{
+		const unsigned char b = msg[i];
+		msg[i] ^= 1 << rnd(8);
+		CHECK(DbfUnserializerInitTakeCrc(&u, msg, len) == DBF_BAD_CRC);
+		msg[i] = b;
+	}
+	// Corrupting the CRC itself may also turn it into something that is not a CRC,
+	// in any case the message must not be OK.
+	for (unsigned int i = payloadLen + 1; i < len; i++)
+	{
+		const unsigned char b = msg[i];
+		msg[i] ^= 1 << rnd(7);
+		CHECK(DbfUnserializerInitTakeCrc(&u, msg, len) != DBF_OK_CRC);
+		msg[i] = b;
+	}
+	CHECK(DbfUnserializerInitTakeCrc(&u, msg, len) == DBF_OK_CRC);
+
+	DbfSerializerDeinit(&plain);
+	DbfSerializerDeinit(&s);
+}
+
+// The usual CRC32 is still what DbfSerializerWriteCrc gives and is checked as before.
+static void test_crc32(void)
+{
+	DbfSerializer s;
+	DbfUnserializer u;
+	DbfSerializerInit(&s);
+	write_fields(&s, 9);
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	check_fields(&u, 9);
+	DbfSerializerDeinit(&s);
+}
+
+int main(void)
+{
+	st_init();
+	test_checksum();
+	for (unsigned int n = 1; n < 40; n++)
+	{
+		test_message(n);
+	}
+	test_crc32();
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
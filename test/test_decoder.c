@@ -0,0 +1,134 @@
+/*
+ * test_decoder.c
+ *
+ * Messages of integer codes are put together byte by byte (as described in dbf.h),
+ * with codes of every length, some with more extension sub codes than needed, and
+ * repeat codes. DbfUnserializerReadInt64 must give the values they were made from.
+ * Each message is at the very end of its own allocation so that codes are also
+ * decoded close to the end of the buffer.
+ * Build and run from the repository root (also with -DDBF_BYTEWISE_DECODER):
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_decoder.c -lpthread -o test_decoder && ./test_decoder
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+static uint64_t rnd64(void)
+{
+	return ((uint64_t)rnd(0x10000) << 48) ^ ((uint64_t)rnd(0x1000000) << 24) ^ rnd(0x1000000);
+}
+
+#define MAX_VALUES 200
+#define MAX_MSG (MAX_VALUES * 12)
+
+// Puts a code with data, sometimes with extension sub codes that only add zeros.
+static unsigned int put_code(unsigned char *p, unsigned int code, unsigned int nofb, uint64_t data)
+{
+	unsigned int n = 0;
+	p[n++] = code + (data & ((1U << nofb) - 1));
+	data = data >> nofb;
+	unsigned int shift = nofb;
+	while (data > 0)
+	{
+		p[n++] = DBF_EXT_CODEID + (data & DBF_EXT_DATAMASK);
+		data = data >> DBF_EXT_DATANBITS;
+		shift += DBF_EXT_DATANBITS;
+	}
+	if (rnd(8) == 0)
+	{
+		for (unsigned int k = rnd(3); (k > 0) && (shift < 64); k--)
+		{
+			p[n++] = DBF_EXT_CODEID;
+			shift += DBF_EXT_DATANBITS;
+		}
+	}
+	return n;
+}
+
+// Number with nb significant bits, not more than 63 so that it is an int64_t.
+static uint64_t random_data(void)
+{
+	const unsigned int nb = rnd(64);
+	if (nb == 0)
+	{
+		return 0;
+	}
+	return (rnd64() | (1ULL << (nb - 1))) & ((1ULL << nb) - 1);
+}
+
+int main(void)
+{
+	static int64_t values[MAX_VALUES * 300];
+	static unsigned char msg[MAX_MSG];
+	st_init();
+	for (unsigned int round = 0; (round < 20000) && (failures == 0); round++)
+	{
+		unsigned int len = 0;
+		unsigned int nofValues = 0;
+		int repeatAllowed = 0;
+		for (unsigned int i = 1 + rnd(rnd(2) ? 10 : MAX_VALUES); i > 0; i--)
+		{
+			if (repeatAllowed && (rnd(5) == 0))
+			{
+				// Repeat the value before, not after another repeat code.
+				const unsigned int r = 1 + rnd(rnd(2) ? 8 : 300);
+				len += put_code(msg + len, DBF_REPEAT_CODEID, DBF_REPEAT_DATANBITS, r);
+				for (unsigned int k = 0; k < r; k++)
+				{
+					values[nofValues] = values[nofValues - 1];
+					nofValues++;
+				}
+				repeatAllowed = 0;
+				continue;
+			}
+			const uint64_t data = random_data();
+			if (rnd(2))
+			{
+				len += put_code(msg + len, DBF_PINT_CODEID, DBF_PINT_DATANBITS, data);
+				values[nofValues++] = (int64_t)data;
+			}
+			else
+			{
+				len += put_code(msg + len, DBF_NINT_CODEID, DBF_NINT_DATANBITS, data);
+				values[nofValues++] = -(int64_t)data - 1;
+			}
+			repeatAllowed = 1;
+		}
+
+		// At the end of an allocation of exactly the message size.
+		unsigned char *p = malloc(len);
+		memcpy(p, msg, len);
+		DbfUnserializer u;
+		DbfUnserializerInitNoCRC(&u, p, len);
+		for (unsigned int i = 0; (i < nofValues) && (failures == 0); i++)
+		{
+			CHECK(DbfUnserializerReadIsNextInt(&u));
+			CHECK(DbfUnserializerReadInt64(&u) == values[i]);
+		}
+		CHECK(DbfUnserializerReadIsNextEnd(&u));
+		free(p);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * test_encoder.c
+ *
+ * Integers of all bit widths, negative ones and runs of same value are written with
+ * DbfSerializerWriteInt64, the bytes must be same as a plain byte by byte encoding
+ * of the codes (as described in dbf.h). Also written into caller given buffers of
+ * every size, nothing may be written beyond the buffer and what fits must be same.
+ * Build and run from the repository root (also with -DDBF_BYTEWISE_ENCODER):
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_encoder.c -lpthread -o test_encoder && ./test_encoder
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+static uint64_t rnd64(void)
+{
+	return ((uint64_t)rnd(0x10000) << 48) ^ ((uint64_t)rnd(0x1000000) << 24) ^ rnd(0x1000000);
+}
+
+// A value with nb significant bits (or the complement of one, negative).
+static int64_t random_value(void)
+{
+	const unsigned int nb = rnd(65);
+	uint64_t v = (nb == 0) ? 0 : (rnd64() | (1ULL << (nb - 1)));
+	if (nb < 64)
+	{
+		v &= (1ULL << nb) - 1;
+	}
+	return rnd(2) ? (int64_t)v : (int64_t)~v;
+}
+
+#define MAX_VALUES 100
+#define MAX_MSG (MAX_VALUES * 12)
+
+static int64_t values[MAX_VALUES];
+static unsigned int nofValues;
+
+// The start sub code with as many bits as fit in it, then 7 bits per extension sub code.
+static unsigned int ref_code(unsigned char *p, unsigned int code, unsigned int nofb, uint64_t data)
+{
+	unsigned int n = 0;
+	p[n++] = code + (data & ((1U << nofb) - 1));
+	data = data >> nofb;
+	while (data > 0)
+	{
+		p[n++] = DBF_EXT_CODEID + (data & DBF_EXT_DATAMASK);
+		data = data >> DBF_EXT_DATANBITS;
+	}
+	return n;
+}
+
+// A value same as the one before is counted in a repeat code (the one before
+// the first is 0, and is also 0 after a repeat code).
+static unsigned int ref_message(unsigned char *p)
+{
+	unsigned int n = 0;
+	int64_t prev = 0;
+	uint64_t repeat = 0;
+	for (unsigned int i = 0; i < nofValues; i++)
+	{
+		const int64_t v = values[i];
+		if (v == prev)
+		{
+			repeat++;
+			continue;
+		}
+		if (repeat > 0)
+		{
+			n += ref_code(p + n, DBF_REPEAT_CODEID, DBF_REPEAT_DATANBITS, repeat);
+			repeat = 0;
+		}
+		if (v >= 0)
+		{
+			n += ref_code(p + n, DBF_PINT_CODEID, DBF_PINT_DATANBITS, v);
+		}
+		else
+		{
+			n += ref_code(p + n, DBF_NINT_CODEID, DBF_NINT_DATANBITS, -1 - v);
+		}
+		prev = v;
+	}
+	if (repeat > 0)
+	{
+		n += ref_code(p + n, DBF_REPEAT_CODEID, DBF_REPEAT_DATANBITS, repeat);
+	}
+	return n;
+}
+
+static void write_values(DbfSerializer *s)
+{
+	for (unsigned int i = 0; i < nofValues; i++)
+	{
+		DbfSerializerWriteInt64(s, values[i]);
+	}
+	DbfSerializerFinalize(s);
+}
+
+int main(void)
+{
+	static unsigned char ref[MAX_MSG];
+	static unsigned char buf[MAX_MSG + 32];
+	st_init();
+	for (unsigned int round = 0; (round < 5000) && (failures == 0); round++)
+	{
+		nofValues = 1 + rnd(MAX_VALUES);
+		for (unsigned int i = 0; i < nofValues; i++)
+		{
+			values[i] = ((i > 0) && (rnd(4) == 0)) ? values[i - 1] : random_value();
+		}
+		const unsigned int len = ref_message(ref);
+
+		DbfSerializer s;
+		DbfSerializerInit(&s);
+		write_values(&s);
+		CHECK(DbfSerializerGetMsgLen(&s) == len);
+		CHECK(memcmp(DbfSerializerGetMsgPtr(&s), ref, len) == 0);
+		DbfSerializerDeinit(&s);
+
+		// Caller given buffer, sometimes too small. Bytes after it must be left as they were.
+		const unsigned int size = rnd(2) ? rnd(len + 16) : len;
+		memset(buf, 0x5a, sizeof(buf));
+		DbfSerializerInitBuffer(&s, buf, size);
+		write_values(&s);
+		if (len <= size)
+		{
+			CHECK(!DbfSerializerIsOverflow(&s));
+			CHECK(DbfSerializerGetMsgLen(&s) == len);
+		}
+		else
+		{
+			CHECK(DbfSerializerIsOverflow(&s));
+			CHECK(DbfSerializerGetMsgLen(&s) <= size);
+		}
+		CHECK(memcmp(buf, ref, DbfSerializerGetMsgLen(&s)) == 0);
+		for (unsigned int i = size; i < sizeof(buf); i++)
+		{
+			CHECK(buf[i] == 0x5a);
+		}
+		DbfSerializerDeinit(&s);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+/*
+ * test_index.c
+ *
+ * Tests of DbfUnserializerBuildIndex and DbfUnserializerSeekField.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_index.c -lpthread -o test_index && ./test_index
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+// Seek to field n and check that it is the integer i.
+static void check_int(DbfUnserializer *u, const DbfIndex *x, unsigned int n, int64_t i)
+{
+	CHECK(DbfUnserializerSeekField(u, x, n) == 0);
+	CHECK(DbfUnserializerReadIsNextInt(u));
+	CHECK(DbfUnserializerReadInt64(u) == i);
+}
+
+// Seek to field n and check that it is the string str (as given by DbfUnserializerRead,
+// strings are quoted, words are not).
+static void check_str(DbfUnserializer *u, const DbfIndex *x, unsigned int n, const char *str)
+{
+	char buf[64];
+	CHECK(DbfUnserializerSeekField(u, x, n) == 0);
+	CHECK(DbfUnserializerReadIsNextString(u) == (str[0] == '\"'));
+	CHECK(DbfUnserializerRead(u, buf, sizeof(buf)) == (int)strlen(str));
+	CHECK(strcmp(buf, str) == 0);
+}
+
+// Empty strings in the middle and last in the message are not fields, reading skips them.
+static void test_empty_string(void)
+{
+	DbfSerializer s;
+	DbfUnserializer u;
+	DbfIndex x;
+	DbfSerializerInit(&s);
+	DbfSerializerWriteInt32(&s, 5);
+	DbfSerializerWriteString(&s, "");
+	DbfSerializerWriteInt32(&s, 7);
+	DbfSerializerWriteString(&s, "ab");
+	DbfSerializerWriteInt32(&s, 9);
+	DbfSerializerWriteString(&s, "");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+
+	DbfIndexInit(&x);
+	CHECK(DbfUnserializerBuildIndex(&u, &x) == 4);
+	check_int(&u, &x, 0, 5);
+	check_int(&u, &x, 1, 7);
+	check_str(&u, &x, 2, "\"ab\"");
+	check_int(&u, &x, 3, 9);
+	CHECK(DbfUnserializerReadIsNextEnd(&u));
+	CHECK(DbfUnserializerSeekField(&u, &x, 4) == -1);
+	DbfIndexDeinit(&x);
+	DbfSerializerDeinit(&s);
+}
+
+// The serializer does not write empty words so this message is put together by hand:
+// 5, empty string, 7, empty word, "ab" as a word, 9, empty word.
+static void test_empty_word(void)
+{
+	static const unsigned char msg[] = {0x45, 0x12, 0x10, 0x47, 0x11, 0x11, 0x61, 0x62, 0x10, 0x49, 0x11};
+	DbfUnserializer u;
+	DbfIndex x;
+	DbfUnserializerInitNoCRC(&u, msg, sizeof(msg));
+
+	DbfIndexInit(&x);
+	CHECK(DbfUnserializerBuildIndex(&u, &x) == 4);
+	check_int(&u, &x, 0, 5);
+	check_int(&u, &x, 1, 7);
+	check_str(&u, &x, 2, "ab");
+	check_int(&u, &x, 3, 9);
+	CHECK(DbfUnserializerReadIsNextEnd(&u));
+	CHECK(DbfUnserializerSeekField(&u, &x, 4) == -1);
+	DbfIndexDeinit(&x);
+}
+
+// Each field found by seeking is same as when all are read from the beginning.
+static void test_same_as_sequential(void)
+{
+	DbfSerializer s;
+	DbfUnserializer u;
+	DbfIndex x;
+	DbfSerializerInit(&s);
+	DbfSerializerWriteInt32(&s, 1);
+	DbfSerializerWriteInt32(&s, 1);
+	DbfSerializerWriteInt32(&s, 1);
+	DbfSerializerWriteString(&s, "hello");
+	DbfSerializerWriteInt64(&s, -123456789012LL);
+	DbfSerializerWriteWord(&s, "cmd");
+	DbfSerializerWriteInt32(&s, 2);
+	DbfSerializerWriteString(&s, "a string that is longer than sixteen characters");
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+
+	DbfIndexInit(&x);
+	CHECK(DbfUnserializerBuildIndex(&u, &x) == 8);
+	check_int(&u, &x, 0, 1);
+	check_int(&u, &x, 1, 1);
+	check_int(&u, &x, 2, 1);
+	check_str(&u, &x, 3, "\"hello\"");
+	check_int(&u, &x, 4, -123456789012LL);
+	check_str(&u, &x, 5, "cmd");
+	check_int(&u, &x, 6, 2);
+	check_str(&u, &x, 7, "\"a string that is longer than sixteen characters\"");
+	check_int(&u, &x, 1, 1);
+	CHECK(DbfUnserializerReadInt64(&u) == 1);
+	DbfIndexDeinit(&x);
+	DbfSerializerDeinit(&s);
+}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+// Reads the rest of both messages, each field must be same.
+static void check_same_rest(DbfUnserializer *a, DbfUnserializer *b)
+{
+	char bufA[64];
+	char bufB[64];
+	while (!DbfUnserializerReadIsNextEnd(a))
+	{
+		CHECK(!DbfUnserializerReadIsNextEnd(b));
+		CHECK(DbfUnserializerReadIsNextInt(a) == DbfUnserializerReadIsNextInt(b));
+		if (DbfUnserializerReadIsNextInt(a))
+		{
+			CHECK(DbfUnserializerReadInt64(a) == DbfUnserializerReadInt64(b));
+		}
+		else
+		{
+			const int n = DbfUnserializerRead(a, bufA, sizeof(bufA));
+			CHECK((n > 0) && (DbfUnserializerRead(b, bufB, sizeof(bufB)) == n) && (strcmp(bufA, bufB) == 0));
+		}
+		if (failures)
+		{
+			return;
+		}
+	}
+	CHECK(DbfUnserializerReadIsNextEnd(b));
+}
+
+// Seeking to field n gives same as n calls to DbfUnserializerSkip, in random messages
+// with repeated integers, words and strings that may be empty.
+static void test_same_as_skip(void)
+{
+	// The serializer gives a repeat code (that DbfUnserializerRead does not handle) if a string
+	// begins with same code as the one before the format code, so strings begin with a character
+	// no string ends with and integers are not below 64 (so not same as any character's code).
+	static const char *strings[] = {"", "", "Sx", "Sab", "Saaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", "Sa string that is longer than sixteen characters"};
+	DbfIndex x;
+	DbfIndexInit(&x);
+	for (unsigned int round = 0; (round < 2000) && (failures == 0); round++)
+	{
+		DbfSerializer s;
+		DbfUnserializer u;
+		DbfUnserializer ref;
+		unsigned int nofFields = 0;
+		DbfSerializerInit(&s);
+		for (unsigned int i = rnd(30); i > 0; i--)
+		{
+			const char *str = strings[rnd(sizeof(strings) / sizeof(strings[0]))];
+			switch (rnd(4))
+			{
+				case 0:
+					DbfSerializerWriteString(&s, str);
+					nofFields += (str[0] != 0);
+					break;
+				case 1:
+					if (str[0] != 0)
+					{
+						DbfSerializerWriteWord(&s, str);
+						nofFields++;
+					}
+					break;
+				default:
+				{
+					const int64_t v = rnd(2) ? 100 + rnd(3) : -1 - (int64_t)rnd(3);
+					for (unsigned int k = 1 + rnd(rnd(2) ? 2 : 10); k > 0; k--)
+					{
+						DbfSerializerWriteInt64(&s, v);
+						nofFields++;
+					}
+					break;
+				}
+			}
+		}
+		DbfSerializerWriteCrc(&s);
+		CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+		CHECK(DbfUnserializerBuildIndex(&u, &x) == (int)nofFields);
+		for (unsigned int n = 0; n <= nofFields; n++)
+		{
+			CHECK(DbfUnserializerInitFromSerializer(&ref, &s) == DBF_OK_CRC);
+			CHECK(DbfUnserializerSkip(&ref, n) == n);
+			if (n < nofFields)
+			{
+				CHECK(DbfUnserializerSeekField(&u, &x, n) == 0);
+				check_same_rest(&u, &ref);
+			}
+			else
+			{
+				CHECK(DbfUnserializerSeekField(&u, &x, n) == -1);
+				CHECK(DbfUnserializerReadIsNextEnd(&ref));
+			}
+		}
+		DbfSerializerDeinit(&s);
+	}
+	DbfIndexDeinit(&x);
+}
+
+int main(void)
+{
+	st_init();
+	test_empty_string();
+	test_empty_word();
+	test_same_as_sequential();
+	test_same_as_skip();
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
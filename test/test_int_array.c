@@ -0,0 +1,188 @@
+/*
+ * test_int_array.c
+ *
+ * DbfSerializerWriteInt64Array must give same message as DbfSerializerWriteInt64 for
+ * each value, and DbfUnserializerReadInt64Array same values as DbfUnserializerReadInt64.
+ * Random messages with arrays (with runs of same value, sizes around the chunk size)
+ * and strings between them, read with arrays of random size, also bigger than what is left.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_int_array.c -lpthread -o test_int_array && ./test_int_array
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+static int64_t random_value(void)
+{
+	int64_t v;
+	switch (rnd(4))
+	{
+		case 0: v = rnd(64); break;
+		case 1: v = -1 - (int64_t)rnd(100); break;
+		case 2: v = ((int64_t)rnd(0x7fffffff) << 32) | rnd(0xffffffff); break;
+		default: v = rnd(100000); break;
+	}
+	// The serializer gives a repeat code (that DbfUnserializerRead does not handle) for a code
+	// same as the one before a format code, so no number has the code of the first or the
+	// last character of the string (from 64 a character's code is the character minus 64).
+	return ((v == 'S' - 64) || (v == 'T' - 64)) ? v + 2 : v;
+}
+
+#define MAX_SEGMENTS 8
+#define MAX_ARRAY 300
+
+typedef struct
+{
+	int64_t values[MAX_ARRAY];
+	size_t n;
+	int string; // A string follows.
+} Segment;
+
+static Segment segments[MAX_SEGMENTS];
+static unsigned int nofSegments;
+
+static void random_message(void)
+{
+	static const size_t sizes[] = {0, 1, 2, 63, 64, 65, 128, 129, MAX_ARRAY};
+	nofSegments = 1 + rnd(MAX_SEGMENTS);
+	for (unsigned int i = 0; i < nofSegments; i++)
+	{
+		Segment *g = &segments[i];
+		g->n = rnd(2) ? sizes[rnd(sizeof(sizes) / sizeof(sizes[0]))] : rnd(MAX_ARRAY);
+		for (size_t k = 0; k < g->n; k++)
+		{
+			g->values[k] = ((k > 0) && (rnd(3) == 0)) ? g->values[k - 1] : random_value();
+		}
+		g->string = rnd(2);
+	}
+}
+
+// With array set each segment is written with one DbfSerializerWriteInt64Array
+// (or a few of them), otherwise one value at a time.
+static void write_message(DbfSerializer *s, int array)
+{
+	for (unsigned int i = 0; i < nofSegments; i++)
+	{
+		const Segment *g = &segments[i];
+		size_t k = 0;
+		while (k < g->n)
+		{
+			size_t m = 1;
+			if (array)
+			{
+				m = rnd(4) ? g->n - k : 1 + rnd(g->n - k);
+				DbfSerializerWriteInt64Array(s, g->values + k, m);
+			}
+			else
+			{
+				DbfSerializerWriteInt64(s, g->values[k]);
+			}
+			k += m;
+		}
+		if (array && (rnd(4) == 0))
+		{
+			DbfSerializerWriteInt64Array(s, NULL, 0);
+		}
+		if (g->string)
+		{
+			DbfSerializerWriteString(s, "ST");
+		}
+	}
+	DbfSerializerWriteCrc(s);
+}
+
+static void read_message(DbfUnserializer *u, int array)
+{
+	static int64_t a[MAX_ARRAY + 10];
+	char buf[16];
+	for (unsigned int i = 0; i < nofSegments; i++)
+	{
+		const Segment *g = &segments[i];
+		size_t k = 0;
+		while (k < g->n)
+		{
+			if (array)
+			{
+				// Ask for more than there are sometimes, when a string follows it stops there.
+				const size_t left = g->n - k;
+				size_t m = rnd(4) ? left : 1 + rnd(left);
+				if (g->string && (rnd(3) == 0))
+				{
+					m = left + 1 + rnd(10);
+				}
+				const size_t got = DbfUnserializerReadInt64Array(u, a, m);
+				CHECK(got == ((m < left) ? m : left));
+				CHECK(memcmp(a, g->values + k, got * sizeof(a[0])) == 0);
+				k += got;
+				if (got == 0)
+				{
+					return;
+				}
+			}
+			else
+			{
+				CHECK(DbfUnserializerReadInt64(u) == g->values[k]);
+				k++;
+			}
+		}
+		if (g->string)
+		{
+			CHECK(!DbfUnserializerReadIsNextInt(u));
+			CHECK(DbfUnserializerReadInt64Array(u, a, 5) == 0);
+			CHECK(DbfUnserializerRead(u, buf, sizeof(buf)) == 4);
+			CHECK(strcmp(buf, "\"ST\"") == 0);
+		}
+		if (failures)
+		{
+			return;
+		}
+	}
+	CHECK(DbfUnserializerReadIsNextEnd(u));
+}
+
+int main(void)
+{
+	st_init();
+	for (unsigned int round = 0; (round < 5000) && (failures == 0); round++)
+	{
+		random_message();
+		DbfSerializer s;
+		DbfSerializer ref;
+		DbfUnserializer u;
+		DbfSerializerInit(&s);
+		DbfSerializerInit(&ref);
+		write_message(&s, 1);
+		write_message(&ref, 0);
+		CHECK(DbfSerializerGetMsgLen(&s) == DbfSerializerGetMsgLen(&ref));
+		CHECK(memcmp(DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgPtr(&ref), DbfSerializerGetMsgLen(&ref)) == 0);
+
+		CHECK(DbfUnserializerInitFromSerializer(&u, &ref) == DBF_OK_CRC);
+		read_message(&u, 1);
+		CHECK(DbfUnserializerInitFromSerializer(&u, &ref) == DBF_OK_CRC);
+		read_message(&u, 0);
+		DbfSerializerDeinit(&s);
+		DbfSerializerDeinit(&ref);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,201 @@
+/*
+ * test_reader.c
+ *
+ * Tests of DbfReader with pipes and socket pairs: end of file, channels removed
+ * from inside the message callback and an unfinished message dropped by the
+ * timer wheel timeout (this one takes DBF_RCV_TIMEOUT_MS). Linux only.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c src/dbf_reader.c test/test_reader.c -lpthread -o test_reader && ./test_reader
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "dbf_reader.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+typedef struct
+{
+	char msgs[8][64]; // Received messages, DBF messages as "dbf:<bytes>", text as "txt:<text>".
+	unsigned int nofMsgs;
+	unsigned int nofClosed;
+	DbfReaderChannel *closed;
+	DbfReaderChannel *removeOnMessage[2]; // Channels to remove when a message is received.
+} Received;
+
+static void on_message(void *user, DbfReaderChannel *channel)
+{
+	Received *rec = user;
+	const DbfReceiver *r = &channel->receiver;
+	if (rec->nofMsgs < 8)
+	{
+		snprintf(rec->msgs[rec->nofMsgs], sizeof(rec->msgs[0]), "%s:%.*s", DbfReceiverIsDbf(r) ? "dbf" : "txt", (int)r->msgSize, (const char*)DbfReceiverGetMsgPtr(r));
+	}
+	rec->nofMsgs++;
+	for (unsigned int i = 0; i < 2; i++)
+	{
+		if (rec->removeOnMessage[i] != NULL)
+		{
+			DbfReaderRemove(channel->reader, rec->removeOnMessage[i]);
+		}
+	}
+}
+
+static void on_closed(void *user, DbfReaderChannel *channel)
+{
+	Received *rec = user;
+	rec->nofClosed++;
+	rec->closed = channel;
+}
+
+static void write_all(int fd, const void *data, size_t n)
+{
+	CHECK(write(fd, data, n) == (ssize_t)n);
+}
+
+// Poll until nothing more happens for a while.
+static void poll_until_quiet(DbfReader *reader)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		if (DbfReaderPoll(reader, 50) == 0)
+		{
+			DbfReaderPoll(reader, 50);
+			return;
+		}
+	}
+}
+
+// Messages are given, then the channel is closed at end of file.
+static void test_end_of_file(void)
+{
+	static const unsigned char data[] = {DBF_BEGIN_CODEID, 'a', 'b', DBF_END_CODEID, 'h', 'i', '\n'};
+	Received rec;
+	DbfReader reader;
+	int fds[2];
+	memset(&rec, 0, sizeof(rec));
+	CHECK(DbfReaderInit(&reader, on_message, on_closed, &rec) == 0);
+	CHECK(pipe(fds) == 0);
+	DbfReaderChannel *channel = DbfReaderAdd(&reader, fds[0], NULL);
+	CHECK(channel != NULL);
+	write_all(fds[1], data, sizeof(data));
+	close(fds[1]);
+	poll_until_quiet(&reader);
+	CHECK(rec.nofMsgs == 2);
+	CHECK(strcmp(rec.msgs[0], "dbf:ab") == 0);
+	CHECK(strcmp(rec.msgs[1], "txt:hi") == 0);
+	CHECK(rec.nofClosed == 1);
+	CHECK(rec.closed == channel);
+	CHECK(reader.nofChannels == 0);
+	close(fds[0]);
+	DbfReaderDeinit(&reader);
+}
+
+// A channel removes itself when its first message is received, the second one
+// (read in the same call) is not given.
+static void test_remove_self(void)
+{
+	static const unsigned char data[] = {DBF_BEGIN_CODEID, 'a', DBF_BEGIN_CODEID, 'b', DBF_END_CODEID};
+	Received rec;
+	DbfReader reader;
+	int sv[2];
+	memset(&rec, 0, sizeof(rec));
+	CHECK(DbfReaderInit(&reader, on_message, on_closed, &rec) == 0);
+	CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	rec.removeOnMessage[0] = DbfReaderAdd(&reader, sv[0], NULL);
+	CHECK(rec.removeOnMessage[0] != NULL);
+	write_all(sv[1], data, sizeof(data));
+	poll_until_quiet(&reader);
+	CHECK(rec.nofMsgs == 1);
+	CHECK(strcmp(rec.msgs[0], "dbf:a") == 0);
+	CHECK(rec.nofClosed == 0);
+	CHECK(reader.nofChannels == 0);
+	close(sv[0]);
+	close(sv[1]);
+	DbfReaderDeinit(&reader);
+}
+
+// Two channels have input, the first one with a message removes both,
+// so the other one (that may also have an event in the same poll) gives nothing.
+static void test_remove_other(void)
+{
+	static const unsigned char data[] = {DBF_BEGIN_CODEID, 'x', DBF_END_CODEID};
+	Received rec;
+	DbfReader reader;
+	int sv0[2];
+	int sv1[2];
+	memset(&rec, 0, sizeof(rec));
+	CHECK(DbfReaderInit(&reader, on_message, on_closed, &rec) == 0);
+	CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv0) == 0);
+	CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv1) == 0);
+	rec.removeOnMessage[0] = DbfReaderAdd(&reader, sv0[0], NULL);
+	rec.removeOnMessage[1] = DbfReaderAdd(&reader, sv1[0], NULL);
+	CHECK((rec.removeOnMessage[0] != NULL) && (rec.removeOnMessage[1] != NULL));
+	write_all(sv0[1], data, sizeof(data));
+	write_all(sv1[1], data, sizeof(data));
+	poll_until_quiet(&reader);
+	CHECK(rec.nofMsgs == 1);
+	CHECK(reader.nofChannels == 0);
+	close(sv0[0]);
+	close(sv0[1]);
+	close(sv1[0]);
+	close(sv1[1]);
+	DbfReaderDeinit(&reader);
+}
+
+// An unfinished DBF message is dropped when the timer wheel times it out. The rest
+// of it, sent after, is then text cut short by the end code, so only the next message is given.
+static void test_timeout(void)
+{
+	static const unsigned char begin[] = {DBF_BEGIN_CODEID, 'a', 'b', 'c'};
+	static const unsigned char rest[] = {'d', 'e', 'f', DBF_END_CODEID, DBF_BEGIN_CODEID, 'g', DBF_END_CODEID};
+	Received rec;
+	DbfReader reader;
+	int fds[2];
+	memset(&rec, 0, sizeof(rec));
+	CHECK(DbfReaderInit(&reader, on_message, on_closed, &rec) == 0);
+	CHECK(pipe(fds) == 0);
+	DbfReaderChannel *channel = DbfReaderAdd(&reader, fds[0], NULL);
+	CHECK(channel != NULL);
+	write_all(fds[1], begin, sizeof(begin));
+	DbfReaderPoll(&reader, 50);
+	CHECK(channel->receiver.receiverState == DbfRcvReceivingMessageState);
+
+	const int64_t end = st_get_posix_time_us() / 1000 + DBF_RCV_TIMEOUT_MS + 4 * DBF_READER_TICK_MS;
+	while ((st_get_posix_time_us() / 1000 < end) && (channel->receiver.receiverState != DbfRcvInitialState))
+	{
+		DbfReaderPoll(&reader, DBF_READER_TICK_MS);
+	}
+	CHECK(channel->receiver.receiverState == DbfRcvInitialState);
+	CHECK(channel->receiver.msgSize == 0);
+
+	write_all(fds[1], rest, sizeof(rest));
+	poll_until_quiet(&reader);
+	CHECK(rec.nofMsgs == 1);
+	CHECK(strcmp(rec.msgs[0], "dbf:g") == 0);
+	close(fds[1]);
+	poll_until_quiet(&reader);
+	CHECK(rec.nofClosed == 1);
+	close(fds[0]);
+	DbfReaderDeinit(&reader);
+}
+
+int main(void)
+{
+	st_init();
+	test_end_of_file();
+	test_remove_self();
+	test_remove_other();
+	test_timeout();
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * test_receiver_bank.c
+ *
+ * A DbfReceiverBank is compared with one DbfReceiver per channel. Both get same
+ * random input (DBF messages, text, noise, big messages, messages cut short) for
+ * random channels at same times, the messages given and the state of each channel
+ * must be same.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_receiver_bank.c -lpthread -o test_receiver_bank && ./test_receiver_bank
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "dbf_buffer_pool.h"
+#include "sys_time.h"
+
+#define NOF_CHANNELS 200
+#define MAX_INPUTS 64
+#define MAX_INPUT_LEN 20000
+#define MAX_MSG_SIZE 5000
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+// Hash of all messages given for each channel, by the receivers and by the bank.
+static uint64_t hashReceivers[NOF_CHANNELS];
+static uint64_t hashBank[NOF_CHANNELS];
+static unsigned long nofReceiverMsgs;
+static unsigned long nofBankMsgs;
+
+static uint64_t hash_msg(uint64_t h, int encoding, const unsigned char *p, unsigned int n)
+{
+	h = h * 1000003 + encoding * 31 + n;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		h = h * 131 + p[i];
+	}
+	return h;
+}
+
+static void on_receiver_message(void *user, DbfReceiver *r)
+{
+	const unsigned int ch = (unsigned int)(size_t)user;
+	hashReceivers[ch] = hash_msg(hashReceivers[ch], DbfReceiverGetEncoding(r), DbfReceiverGetMsgPtr(r), r->msgSize);
+	nofReceiverMsgs++;
+}
+
+static void on_bank_message(void *user, unsigned int ch, const DbfSlice *msg)
+{
+	(void)user;
+	hashBank[ch] = hash_msg(hashBank[ch], msg->encoding, msg->ptr, msg->len);
+	nofBankMsgs++;
+}
+
+static unsigned int random_len(void)
+{
+	// Sometimes bigger than the inline buffer of DbfReceiver, or than max message size.
+	return (rnd(20) == 0) ? 900 + rnd(6000) : rnd(60);
+}
+
+// Random input for one channel, may end in the middle of a message.
+static unsigned int random_input(unsigned char *p)
+{
+	unsigned int n = 0;
+	while (n < MAX_INPUT_LEN - 8000)
+	{
+		const uint32_t t = rnd(10);
+		if (t < 4)
+		{
+			p[n++] = DBF_BEGIN_CODEID;
+			for (unsigned int i = random_len(); i > 0; i--)
+			{
+				p[n++] = 2 + rnd(254);
+			}
+			if (rnd(4) != 0)
+			{
+				p[n++] = DBF_END_CODEID;
+			}
+		}
+		else if (t < 8)
+		{
+			for (unsigned int i = random_len(); i > 0; i--)
+			{
+				p[n++] = ' ' + rnd('~' - ' ' + 1);
+			}
+			p[n++] = rnd(2) ? '\n' : '\r';
+		}
+		else if (t < 9)
+		{
+			for (unsigned int i = rnd(10); i > 0; i--)
+			{
+				p[n++] = rnd(256);
+			}
+		}
+		else
+		{
+			static const unsigned char c[] = {'\t', '\n', '\r', DBF_END_CODEID, DBF_BEGIN_CODEID, 0x7f};
+			p[n++] = c[rnd(sizeof(c))];
+		}
+		if (rnd(8) == 0)
+		{
+			break;
+		}
+	}
+	if (rnd(5) == 0)
+	{
+		n = rnd(n + 1);
+	}
+	return n;
+}
+
+static void check_same_state(const DbfReceiver *r, const DbfReceiverBank *bank, unsigned int ch)
+{
+	const int state = r->receiverState;
+	CHECK(state == bank->states[ch]);
+	CHECK(r->msgSize == bank->msgSizes[ch]);
+	if ((state == DbfRcvIgnoreInputState) || (state == DbfRcvReceivingMessageState))
+	{
+		CHECK((uint32_t)r->msgtimestamp == bank->timestamps[ch]);
+	}
+	if (r->msgSize > 0)
+	{
+		CHECK(memcmp(r->bufPtr, bank->bufPtrs[ch], r->msgSize) == 0);
+	}
+}
+
+int main(void)
+{
+	static DbfReceiver receivers[NOF_CHANNELS];
+	static unsigned char data[MAX_INPUTS][MAX_INPUT_LEN];
+	DbfReceiverBankInput inputs[MAX_INPUTS];
+	DbfBufferPool receiverPool;
+	DbfBufferPool bankPool;
+	DbfReceiverBank bank;
+	DbfClock clock;
+	DbfBufferPoolStats stats;
+
+	st_init();
+	DbfBufferPoolInit(&receiverPool, 0, DbfBufferPoolDrop, 16);
+	DbfBufferPoolInit(&bankPool, 0, DbfBufferPoolDrop, 16);
+	DbfClockInitTick(&clock, 7);
+	clock.ms = 100000;
+	for (unsigned int i = 0; i < NOF_CHANNELS; i++)
+	{
+		DbfReceiverInit(&receivers[i]);
+		DbfReceiverSetClock(&receivers[i], &clock);
+		DbfReceiverSetMaxMsgSize(&receivers[i], MAX_MSG_SIZE);
+		DbfReceiverSetBufferPool(&receivers[i], &receiverPool);
+	}
+	DbfReceiverBankInit(&bank, NOF_CHANNELS, &bankPool);
+	DbfReceiverBankSetClock(&bank, &clock);
+	DbfReceiverBankSetMaxMsgSize(&bank, MAX_MSG_SIZE);
+
+	for (unsigned int round = 0; (round < 3000) && (failures == 0); round++)
+	{
+		const unsigned int nofInputs = 1 + rnd(MAX_INPUTS);
+		for (unsigned int k = 0; k < nofInputs; k++)
+		{
+			inputs[k].channel = rnd(NOF_CHANNELS);
+			inputs[k].ptr = data[k];
+			inputs[k].len = random_input(data[k]);
+		}
+		for (unsigned int k = 0; k < nofInputs; k++)
+		{
+			const unsigned int ch = inputs[k].channel;
+			DbfReceiverProcessBuffer(&receivers[ch], inputs[k].ptr, inputs[k].len, on_receiver_message, (void*)(size_t)ch);
+		}
+		DbfReceiverBankProcess(&bank, inputs, nofInputs, on_bank_message, NULL);
+
+		// Time passes, sometimes the timeouts are checked.
+		for (unsigned int t = rnd(300); t > 0; t--)
+		{
+			DbfClockTick(&clock);
+		}
+		if (rnd(3) == 0)
+		{
+			for (unsigned int i = 0; i < NOF_CHANNELS; i++)
+			{
+				DbfReceiverCheckTimeout(&receivers[i], DBF_RCV_TIMEOUT_MS);
+			}
+			DbfReceiverBankCheckTimeout(&bank, DBF_RCV_TIMEOUT_MS);
+		}
+		for (unsigned int i = 0; i < NOF_CHANNELS; i++)
+		{
+			check_same_state(&receivers[i], &bank, i);
+		}
+	}
+
+	CHECK(nofReceiverMsgs == nofBankMsgs);
+	for (unsigned int i = 0; i < NOF_CHANNELS; i++)
+	{
+		CHECK(hashReceivers[i] == hashBank[i]);
+	}
+	printf("%lu messages\n", nofBankMsgs);
+
+	for (unsigned int i = 0; i < NOF_CHANNELS; i++)
+	{
+		DbfReceiverDeinit(&receivers[i]);
+	}
+	DbfReceiverBankDeinit(&bank);
+	// All buffers were given back to the pool.
+	DbfBufferPoolGetStats(&bankPool, &stats);
+	CHECK(stats.current_bytes == stats.free_bytes);
+	DbfBufferPoolDeinit(&receiverPool);
+	DbfBufferPoolDeinit(&bankPool);
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
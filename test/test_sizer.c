@@ -0,0 +1,197 @@
+/*
+ * test_sizer.c
+ *
+ * Random messages are sized with DbfSizer and then written to a serializer that
+ * has reserved that size, with DbfSerializerInitReserve or DbfSerializerReserve.
+ * The buffer must not be reallocated (same pointer and capacity) and the size
+ * given by DbfSizer must be exact (up to 4 bytes less with a CRC).
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_sizer.c -lpthread -o test_sizer && ./test_sizer
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+// Small, large and negative values, with runs of same value (repeat codes).
+static int64_t random_value(void)
+{
+	switch (rnd(5))
+	{
+		case 0: return rnd(64);
+		case 1: return -1 - (int64_t)rnd(1000);
+		case 2: return ((int64_t)rnd(0xffffffff) << 31) ^ rnd(0xffffffff);
+		case 3: return INT64_MIN + rnd(10);
+		default: return rnd(100000);
+	}
+}
+
+#define MAX_ARRAY 729
+
+typedef struct
+{
+	int type;
+	int64_t values[MAX_ARRAY];
+	size_t n;
+	char str[40];
+} Field;
+
+#define MAX_FIELDS 20
+
+static Field fields[MAX_FIELDS];
+static unsigned int nofFields;
+static int crcType; // 0 none, 1 CRC, 2 CRC32C
+
+static void random_message(void)
+{
+	static const size_t arraySizes[] = {0, 1, 9, 63, 64, 65, MAX_ARRAY};
+	nofFields = rnd(MAX_FIELDS + 1);
+	for (unsigned int i = 0; i < nofFields; i++)
+	{
+		Field *f = &fields[i];
+		f->type = rnd(4);
+		f->n = arraySizes[rnd(sizeof(arraySizes) / sizeof(arraySizes[0]))];
+		int64_t v = random_value();
+		for (size_t k = 0; k < f->n; k++)
+		{
+			if (rnd(3) == 0)
+			{
+				v = random_value();
+			}
+			f->values[k] = v;
+		}
+		const unsigned int len = rnd(sizeof(f->str));
+		for (unsigned int k = 0; k < len; k++)
+		{
+			f->str[k] = rnd(4) ? 'a' + rnd(rnd(2) ? 3 : 26) : ' ';
+		}
+		f->str[len] = 0;
+		if ((f->type == 3) && (f->str[0] <= ' '))
+		{
+			// Not a word.
+			f->type = 2;
+		}
+	}
+	crcType = rnd(3);
+}
+
+// With first set the integer 7 is sized first, it is written before the reserve.
+static unsigned long size_message(int first)
+{
+	DbfSizer z;
+	DbfSizerInit(&z);
+	if (first)
+	{
+		DbfSizerWriteInt64(&z, 7);
+	}
+	for (unsigned int i = 0; i < nofFields; i++)
+	{
+		const Field *f = &fields[i];
+		switch (f->type)
+		{
+			case 0: DbfSizerWriteInt64Array(&z, f->values, f->n); break;
+			case 1: DbfSizerWriteInt64(&z, f->n ? f->values[0] : 0); break;
+			case 2: DbfSizerWriteString(&z, f->str); break;
+			default: DbfSizerWriteWord(&z, f->str); break;
+		}
+	}
+	if (crcType == 1)
+	{
+		DbfSizerWriteCrc(&z);
+	}
+	else if (crcType == 2)
+	{
+		DbfSizerWriteCrc32c(&z);
+	}
+	return DbfSizerGetMsgLen(&z);
+}
+
+static void write_message(DbfSerializer *s)
+{
+	for (unsigned int i = 0; i < nofFields; i++)
+	{
+		const Field *f = &fields[i];
+		switch (f->type)
+		{
+			case 0: DbfSerializerWriteInt64Array(s, f->values, f->n); break;
+			case 1: DbfSerializerWriteInt64(s, f->n ? f->values[0] : 0); break;
+			case 2: DbfSerializerWriteString(s, f->str); break;
+			default: DbfSerializerWriteWord(s, f->str); break;
+		}
+	}
+	if (crcType == 1)
+	{
+		DbfSerializerWriteCrc(s);
+	}
+	else if (crcType == 2)
+	{
+		DbfSerializerWriteCrc32c(s);
+	}
+	else
+	{
+		DbfSerializerFinalize(s);
+	}
+}
+
+static void check_size(const DbfSerializer *s, unsigned long size)
+{
+	const unsigned long len = DbfSerializerGetMsgLen(s);
+	CHECK(len <= size);
+	CHECK(len + ((crcType != 0) ? 4 : 0) >= size);
+	CHECK(!DbfSerializerIsOverflow(s));
+}
+
+int main(void)
+{
+	st_init();
+	for (unsigned int round = 0; (round < 20000) && (failures == 0); round++)
+	{
+		random_message();
+		const unsigned long size = size_message(0);
+
+		// Reserved when initialized.
+		DbfSerializer s;
+		DbfSerializerInitReserve(&s, size);
+		const unsigned char *buffer = s.buffer;
+		const unsigned int capacity = s.capacity;
+		write_message(&s);
+		CHECK(s.buffer == buffer);
+		CHECK(s.capacity == capacity);
+		check_size(&s, size);
+		DbfSerializerDeinit(&s);
+
+		// Reserved after an integer was written.
+		const unsigned long size2 = size_message(1);
+		DbfSerializerInit(&s);
+		DbfSerializerWriteInt64(&s, 7);
+		DbfSerializerReserve(&s, size2 - s.pos);
+		const unsigned char *buffer2 = s.buffer;
+		const unsigned int capacity2 = s.capacity;
+		write_message(&s);
+		CHECK(s.buffer == buffer2);
+		CHECK(s.capacity == capacity2);
+		check_size(&s, size2);
+		DbfSerializerDeinit(&s);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
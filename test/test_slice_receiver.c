@@ -0,0 +1,331 @@
+/*
+ * test_slice_receiver.c
+ *
+ * Random streams are framed by DbfSliceReceiver and by DbfReceiverProcessBuffer,
+ * the messages given must be same. Bytes are given in random sized chunks and
+ * slices are held and released at random, so receiving also continues at the
+ * beginning of the buffer while old slices are kept at its end.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_slice_receiver.c -lpthread -o test_slice_receiver && ./test_slice_receiver
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+#define MAX_STREAM 20000
+#define MAX_MSGS 4000
+
+typedef struct
+{
+	int encoding;
+	unsigned int pos;
+	unsigned int len;
+} Msg;
+
+static unsigned char stream[MAX_STREAM + 256];
+static unsigned int streamLen;
+
+// Messages as given by DbfReceiver, their bytes are kept in msgData.
+static unsigned char msgData[MAX_STREAM * 2];
+static unsigned int msgDataLen;
+static Msg msgs[MAX_MSGS];
+static unsigned int nofMsgs;
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+static void put(unsigned char ch)
+{
+	stream[streamLen++] = ch;
+}
+
+static void put_printable(unsigned int n)
+{
+	for (unsigned int i = 0; i < n; i++)
+	{
+		put(' ' + rnd('~' - ' ' + 1));
+	}
+}
+
+// A byte that is neither printable nor a delimiter.
+static unsigned char noise_byte(void)
+{
+	static const unsigned char c[] = {0x02, 0x03, 0x07, 0x1b, 0x7f, 0x80, 0x9b, 0xc3, 0xff};
+	return c[rnd(sizeof(c))];
+}
+
+// The body of a DBF message, the begin code is already put.
+// Ends with the end code or with a begin code that also begins next message.
+static int put_dbf_body(void)
+{
+	const unsigned int n = rnd(8) ? rnd(60) : 0;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		put(2 + rnd(254));
+	}
+	if (rnd(4) == 0)
+	{
+		put(DBF_BEGIN_CODEID);
+		return 1;
+	}
+	put(DBF_END_CODEID);
+	return 0;
+}
+
+// Noise is only left at a DBF begin code (DbfReceiver waits for silence otherwise),
+// so the stream is generated in tokens that both receivers frame same way.
+static void make_stream(void)
+{
+	int inDbf = 0;
+	streamLen = 0;
+	while (streamLen < MAX_STREAM)
+	{
+		if (inDbf)
+		{
+			inDbf = put_dbf_body();
+			continue;
+		}
+		switch (rnd(8))
+		{
+			case 0:
+			case 1:
+				put(DBF_BEGIN_CODEID);
+				inDbf = put_dbf_body();
+				break;
+			case 2:
+			case 3:
+				// A text line, perhaps beginning with a tab.
+				if (rnd(4) == 0)
+				{
+					put('\t');
+				}
+				put_printable(rnd(80));
+				switch (rnd(3))
+				{
+					case 0: put('\n'); break;
+					case 1: put('\r'); break;
+					default: put('\r'); put('\n'); break;
+				}
+				break;
+			case 4:
+				// Text cut short by a DBF begin or end code.
+				put_printable(1 + rnd(40));
+				if (rnd(2))
+				{
+					put(DBF_BEGIN_CODEID);
+					inDbf = put_dbf_body();
+				}
+				else
+				{
+					put(DBF_END_CODEID);
+				}
+				break;
+			case 5:
+				// Noise, perhaps after some text, with more text in it. No line ends
+				// since the slice receiver leaves noise at those.
+				put_printable(rnd(2) ? 0 : 1 + rnd(20));
+				put(noise_byte());
+				for (unsigned int n = rnd(20); n > 0; n--)
+				{
+					switch (rnd(3))
+					{
+						case 0: put(noise_byte()); break;
+						case 1: put('\t'); break;
+						default: put_printable(1); break;
+					}
+				}
+				put(DBF_BEGIN_CODEID);
+				inDbf = put_dbf_body();
+				break;
+			case 6:
+				// Delimiters between messages.
+				put(rnd(2) ? DBF_END_CODEID : '\n');
+				break;
+			default:
+				// Empty DBF message.
+				put(DBF_BEGIN_CODEID);
+				put(DBF_END_CODEID);
+				break;
+		}
+	}
+	if (inDbf)
+	{
+		put(DBF_END_CODEID);
+	}
+}
+
+static void on_message(void *user, DbfReceiver *r)
+{
+	(void)user;
+	const unsigned int len = r->msgSize;
+	CHECK(nofMsgs < MAX_MSGS);
+	if (nofMsgs >= MAX_MSGS)
+	{
+		return;
+	}
+	msgs[nofMsgs].encoding = DbfReceiverGetEncoding(r);
+	msgs[nofMsgs].pos = msgDataLen;
+	msgs[nofMsgs].len = len;
+	memcpy(msgData + msgDataLen, DbfReceiverGetMsgPtr(r), len);
+	msgDataLen += len;
+	nofMsgs++;
+}
+
+// Frame the stream with DbfReceiver, time does not pass so noise is never timed out.
+static void receive_reference(void)
+{
+	DbfReceiver r;
+	DbfClock clock;
+	DbfClockInitTick(&clock, 0);
+	clock.ms = 100000;
+	DbfReceiverInit(&r);
+	DbfReceiverSetClock(&r, &clock);
+	nofMsgs = 0;
+	msgDataLen = 0;
+	unsigned int pos = 0;
+	while (pos < streamLen)
+	{
+		unsigned int n = 1 + rnd(300);
+		if (n > streamLen - pos)
+		{
+			n = streamLen - pos;
+		}
+		DbfReceiverProcessBuffer(&r, stream + pos, n, on_message, NULL);
+		pos += n;
+	}
+	DbfReceiverDeinit(&r);
+}
+
+static int same_as_msg(const DbfSlice *slice, unsigned int i)
+{
+	return (i < nofMsgs) && ((int)slice->encoding == msgs[i].encoding) && (slice->len == msgs[i].len) &&
+		(memcmp(slice->ptr, msgData + msgs[i].pos, slice->len) == 0);
+}
+
+// Slices taken and not released, oldest first.
+static DbfSlice held[DBF_SLICE_RECEIVER_MAX_SLICES];
+static unsigned int heldIndex[DBF_SLICE_RECEIVER_MAX_SLICES];
+static unsigned int nofHeld;
+static unsigned int nofTaken;
+
+static int take(DbfSliceReceiver *sr)
+{
+	DbfSlice slice;
+	if (!DbfSliceReceiverNext(sr, &slice))
+	{
+		return 0;
+	}
+	CHECK(same_as_msg(&slice, nofTaken));
+	held[nofHeld] = slice;
+	heldIndex[nofHeld] = nofTaken;
+	nofHeld++;
+	nofTaken++;
+	return 1;
+}
+
+// The slice must not have been overwritten while it was held.
+static void release(DbfSliceReceiver *sr)
+{
+	CHECK(same_as_msg(&held[0], heldIndex[0]));
+	memmove(held, held + 1, (nofHeld - 1) * sizeof(held[0]));
+	memmove(heldIndex, heldIndex + 1, (nofHeld - 1) * sizeof(heldIndex[0]));
+	nofHeld--;
+	DbfSliceReceiverRelease(sr);
+}
+
+// Returns number of times receiving continued at beginning of buffer.
+static unsigned int receive_slices(unsigned int size)
+{
+	static unsigned char buf[4096];
+	DbfSliceReceiver sr;
+	unsigned int wraps = 0;
+	DbfSliceReceiverInit(&sr, buf, size);
+	nofHeld = 0;
+	nofTaken = 0;
+	unsigned int pos = 0;
+	while (pos < streamLen)
+	{
+		unsigned int avail;
+		unsigned char *w = DbfSliceReceiverGetWritePtr(&sr, &avail);
+		if (avail == 0)
+		{
+			// Make room.
+			if ((nofHeld == 0) && !take(&sr))
+			{
+				printf("stuck at %u\n", pos);
+				failures++;
+				return wraps;
+			}
+			release(&sr);
+			continue;
+		}
+		unsigned int n = 1 + rnd(200);
+		if (n > avail)
+		{
+			n = avail;
+		}
+		if (n > streamLen - pos)
+		{
+			n = streamLen - pos;
+		}
+		memcpy(w, stream + pos, n);
+		pos += n;
+		DbfSliceReceiverCommit(&sr, n);
+		if (sr.nofOld > 0)
+		{
+			wraps++;
+		}
+		for (unsigned int k = rnd(4); (k > 0) && take(&sr); k--)
+		{
+		}
+		for (unsigned int k = rnd(3); (k > 0) && (nofHeld > 0); k--)
+		{
+			release(&sr);
+		}
+	}
+	while (take(&sr) || (nofHeld > 0))
+	{
+		while (nofHeld > 0)
+		{
+			release(&sr);
+		}
+	}
+	CHECK(nofTaken == nofMsgs);
+	return wraps;
+}
+
+int main(void)
+{
+	st_init();
+	unsigned int wraps = 0;
+	unsigned int total = 0;
+	for (unsigned int round = 0; (round < 200) && (failures == 0); round++)
+	{
+		make_stream();
+		receive_reference();
+		wraps += receive_slices(256 + rnd(4096 - 256 + 1));
+		total += nofMsgs;
+	}
+	// Make sure the test did what it is meant to.
+	CHECK(wraps > 0);
+	printf("%u messages, %u wraps\n", total, wraps);
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * test_string_alloc.c
+ *
+ * Tests of DbfUnserializerReadStringAlloc and DbfArena. Strings are compared with
+ * what DbfUnserializerRead gives, strings read earlier must stay as they were while
+ * later ones are moved to bigger blocks, and all strings are zero terminated.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_string_alloc.c -lpthread -o test_string_alloc && ./test_string_alloc
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+#define NOF_STRINGS 40
+#define MAX_LEN 3000
+
+static char strings[NOF_STRINGS][MAX_LEN + 1];
+
+// Numbers written between the strings. Not small numbers since the serializer would
+// then give a repeat code for a string beginning with the character that has same code,
+// which DbfUnserializerRead does not handle.
+#define FIELD_NR(i) (1000 + (i))
+
+// Random length, some longer than the first arena block, some with long runs of
+// same character (repeat codes) and some characters that are not one byte codes.
+static void random_string(char *str)
+{
+	const unsigned int n = rnd(4) ? rnd(40) : rnd(MAX_LEN);
+	unsigned int i = 0;
+	while (i < n)
+	{
+		const char ch = rnd(8) ? 'a' + rnd(26) : (rnd(2) ? '~' : ' ');
+		unsigned int r = rnd(10) ? 1 : rnd(100);
+		while ((r > 0) && (i < n))
+		{
+			str[i++] = ch;
+			r--;
+		}
+	}
+	str[i] = 0;
+}
+
+// Strings and words are read into the arena, then all of them are checked.
+static void test_binary(void)
+{
+	char buf[MAX_LEN + 3];
+	const char *got[NOF_STRINGS];
+	size_t lens[NOF_STRINGS];
+	DbfSerializer s;
+	DbfUnserializer u;
+	DbfUnserializer ref;
+	DbfArena a;
+	DbfArenaInit(&a, 0);
+	for (unsigned int round = 0; round < 200; round++)
+	{
+		DbfSerializerInit(&s);
+		for (unsigned int i = 0; i < NOF_STRINGS; i++)
+		{
+			random_string(strings[i]);
+			if ((i % 3 == 2) && (strings[i][0] != 0) && (strchr(strings[i], ' ') == NULL))
+			{
+				DbfSerializerWriteWord(&s, strings[i]);
+			}
+			else
+			{
+				DbfSerializerWriteString(&s, strings[i]);
+			}
+			DbfSerializerWriteInt32(&s, FIELD_NR(i));
+		}
+		DbfSerializerWriteCrc(&s);
+		CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+		CHECK(DbfUnserializerInitFromSerializer(&ref, &s) == DBF_OK_CRC);
+
+		for (unsigned int i = 0; i < NOF_STRINGS; i++)
+		{
+			if (strings[i][0] == 0)
+			{
+				// Empty strings are skipped when reading in order.
+				CHECK(DbfUnserializerReadInt64(&u) == FIELD_NR(i));
+				CHECK(DbfUnserializerReadInt64(&ref) == FIELD_NR(i));
+				got[i] = "";
+				lens[i] = 0;
+				continue;
+			}
+			const int quoted = DbfUnserializerReadIsNextString(&ref);
+			const int k = DbfUnserializerRead(&ref, buf, sizeof(buf));
+			got[i] = DbfUnserializerReadStringAlloc(&u, &a, &lens[i]);
+			CHECK(got[i] != NULL);
+			if (got[i] == NULL)
+			{
+				return;
+			}
+			CHECK((int)lens[i] == k - (quoted ? 2 : 0));
+			CHECK(memcmp(got[i], buf + (quoted ? 1 : 0), lens[i]) == 0);
+			CHECK(DbfUnserializerReadInt64(&u) == FIELD_NR(i));
+			CHECK(DbfUnserializerReadInt64(&ref) == FIELD_NR(i));
+		}
+		CHECK(DbfUnserializerReadIsNextEnd(&u));
+
+		// None was overwritten when later ones were read.
+		for (unsigned int i = 0; i < NOF_STRINGS; i++)
+		{
+			CHECK(lens[i] == strlen(strings[i]));
+			CHECK(strcmp(got[i], strings[i]) == 0);
+		}
+		DbfSerializerDeinit(&s);
+		if (rnd(2))
+		{
+			DbfArenaReset(&a);
+		}
+	}
+	DbfArenaDeinit(&a);
+}
+
+// A shorter string read where a longer one was before must still be zero terminated.
+static void test_ascii_terminated(void)
+{
+	static const char longer[] = "\"XXXXXXXXXXXXXXXXXXXXXXXXXXXXXX\" 1";
+	static const char shorter[] = "\"ab\" 1";
+	DbfUnserializer u;
+	DbfArena a;
+	size_t len;
+	DbfArenaInit(&a, 0);
+
+	DbfUnserializerInitAscii(&u, (const unsigned char*)longer, sizeof(longer) - 1);
+	const char *str = DbfUnserializerReadStringAlloc(&u, &a, &len);
+	CHECK((str != NULL) && (len == 30) && (strlen(str) == 30));
+	CHECK(DbfUnserializerReadInt64(&u) == 1);
+
+	DbfArenaReset(&a);
+	DbfUnserializerInitAscii(&u, (const unsigned char*)shorter, sizeof(shorter) - 1);
+	str = DbfUnserializerReadStringAlloc(&u, &a, &len);
+	CHECK((str != NULL) && (len == 2));
+	CHECK((str != NULL) && (strcmp(str, "ab") == 0));
+	CHECK(DbfUnserializerReadInt64(&u) == 1);
+
+	// Words also.
+	static const char word[] = "hello 2";
+	DbfUnserializerInitAscii(&u, (const unsigned char*)word, sizeof(word) - 1);
+	str = DbfUnserializerReadStringAlloc(&u, &a, &len);
+	CHECK((str != NULL) && (len == 5) && (strcmp(str, "hello") == 0));
+	CHECK(DbfUnserializerReadInt64(&u) == 2);
+	DbfArenaDeinit(&a);
+}
+
+// An integer is not a string.
+static void test_not_string(void)
+{
+	DbfSerializer s;
+	DbfUnserializer u;
+	DbfArena a;
+	DbfArenaInit(&a, 64);
+	DbfSerializerInit(&s);
+	DbfSerializerWriteInt32(&s, 5);
+	DbfSerializerWriteCrc(&s);
+	CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+	CHECK(DbfUnserializerReadStringAlloc(&u, &a, NULL) == NULL);
+	CHECK(DbfUnserializerReadInt64(&u) == 5);
+	DbfSerializerDeinit(&s);
+	DbfArenaDeinit(&a);
+}
+
+int main(void)
+{
+	st_init();
+	test_binary();
+	test_ascii_terminated();
+	test_not_string();
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * test_string_read.c
+ *
+ * Strings and words are read with DbfUnserializerRead into buffers of random size and
+ * compared with what reading one character at a time gives: the quoted string cut at
+ * the buffer size (the end quote only if there is room for it) and zero terminated.
+ * Strings have blocks of one byte codes, repeated characters and characters with
+ * longer codes, so the 16 at a time decoding starts and stops everywhere.
+ * DbfUnserializerStringLength must give the length of the entire string (without quotes).
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_string_read.c -lpthread -o test_string_read && ./test_string_read
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+#define NOF_STRINGS 20
+#define MAX_LEN 120
+
+static char strings[NOF_STRINGS][MAX_LEN + 1];
+static int isWord[NOF_STRINGS];
+
+static void random_string(char *str, int word)
+{
+	const unsigned int n = (word ? 1 : 0) + rnd(rnd(2) ? 20 : MAX_LEN);
+	unsigned int i = 0;
+	while (i < n)
+	{
+		char ch;
+		switch (rnd(20))
+		{
+			case 0: ch = word ? '|' : '\t'; break; // A tab is not a one byte code.
+			case 1: ch = word ? '_' : ' '; break;
+			default: ch = '!' + rnd('~' - '!' + 1); break;
+		}
+		if ((word && ((ch == '\"') || (ch == '\\'))) || (ch == '@'))
+		{
+			// Not part of a word. The code of '@' is 0, same as the code before the first
+			// in a message, so the serializer would give a repeat code for it (see below).
+			ch = 'w';
+		}
+		for (unsigned int r = rnd(8) ? 1 : 1 + rnd(40); (r > 0) && (i < n); r--)
+		{
+			str[i++] = ch;
+		}
+	}
+	str[i] = 0;
+}
+
+// What reading one character at a time gives.
+static int ref_read(const char *str, int quoted, char *buf, size_t cap)
+{
+	size_t n = 0;
+	if (quoted && (n < cap))
+	{
+		buf[n++] = '\"';
+	}
+	for (const char *p = str; *p; p++)
+	{
+		if (n < cap)
+		{
+			buf[n] = *p;
+		}
+		n++;
+	}
+	if (quoted && (n < cap))
+	{
+		buf[n++] = '\"';
+	}
+	if (n < cap)
+	{
+		buf[n] = 0;
+	}
+	else if (cap > 0)
+	{
+		buf[cap - 1] = 0;
+	}
+	return n;
+}
+
+int main(void)
+{
+	char buf[MAX_LEN + 32];
+	char ref[MAX_LEN + 32];
+	st_init();
+	for (unsigned int round = 0; (round < 20000) && (failures == 0); round++)
+	{
+		// A number between the strings, the serializer would give a repeat code
+		// for a string beginning with same code as the one before (see test_string_alloc.c).
+		DbfSerializer s;
+		DbfSerializerInit(&s);
+		for (unsigned int i = 0; i < NOF_STRINGS; i++)
+		{
+			isWord[i] = rnd(3) == 0;
+			random_string(strings[i], isWord[i]);
+			if (isWord[i])
+			{
+				DbfSerializerWriteWord(&s, strings[i]);
+			}
+			else
+			{
+				DbfSerializerWriteString(&s, strings[i]);
+			}
+			DbfSerializerWriteInt32(&s, 1000 + i);
+		}
+		DbfSerializerWriteCrc(&s);
+
+		DbfUnserializer u;
+		CHECK(DbfUnserializerInitFromSerializer(&u, &s) == DBF_OK_CRC);
+		for (unsigned int i = 0; (i < NOF_STRINGS) && (failures == 0); i++)
+		{
+			if (strings[i][0] == 0)
+			{
+				// Empty strings are skipped.
+				CHECK(DbfUnserializerReadInt64(&u) == 1000 + i);
+				continue;
+			}
+			const int quoted = !isWord[i];
+			const size_t full = strlen(strings[i]) + (quoted ? 2 : 0);
+			CHECK(DbfUnserializerStringLength(&u) == (long)strlen(strings[i]));
+
+			const size_t cap = rnd(3) ? full + 1 + rnd(4) : rnd(full + 2);
+			memset(buf, 0x5a, sizeof(buf));
+			memset(ref, 0x5a, sizeof(ref));
+			const int n = ref_read(strings[i], quoted, ref, cap);
+			CHECK(DbfUnserializerRead(&u, buf, cap) == n);
+			CHECK(memcmp(buf, ref, sizeof(buf)) == 0);
+			CHECK(DbfUnserializerReadInt64(&u) == 1000 + i);
+		}
+		CHECK(DbfUnserializerReadIsNextEnd(&u));
+		DbfSerializerDeinit(&s);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,239 @@
+/*
+ * test_string_write.c
+ *
+ * Random strings, words and numbers are written and the bytes compared with a plain
+ * model of the encoder, one code per character with runs folded into repeat codes.
+ * Strings have blocks of printable characters, repeated characters and characters
+ * outside the one byte range, so the 16 at a time encoding starts and stops
+ * everywhere. Also written into caller given buffers of random size (nothing may be
+ * written beyond them) and with the running CRC (same message and CRC).
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_string_write.c -lpthread -o test_string_write && ./test_string_write
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+#define NOF_FIELDS 12
+#define MAX_LEN 100
+#define MAX_MSG (NOF_FIELDS * (MAX_LEN + 4) * 2)
+
+typedef struct
+{
+	int type; // 0 number, 1 string, 2 word
+	int64_t value;
+	char str[MAX_LEN + 1];
+} Field;
+
+static Field fields[NOF_FIELDS];
+
+static void random_string(char *str, int word)
+{
+	const unsigned int n = (word ? 1 : 0) + rnd(rnd(2) ? 20 : MAX_LEN);
+	unsigned int i = 0;
+	while (i < n)
+	{
+		char ch;
+		switch (rnd(30))
+		{
+			case 0: ch = 1 + rnd(31); break;
+			case 1: ch = (char)(128 + rnd(128)); break;
+			case 2: ch = 0x7f; break;
+			default: ch = ' ' + rnd('~' - ' ' + 1); break;
+		}
+		if (word && ((ch <= ' ') || (ch == '\"') || (ch == '\\') || (ch == 0x7f)))
+		{
+			// Not part of a word.
+			ch = 'w';
+		}
+		for (unsigned int r = rnd(6) ? 1 : 1 + rnd(30); (r > 0) && (i < n); r--)
+		{
+			str[i++] = ch;
+		}
+	}
+	str[i] = 0;
+}
+
+static void random_message(void)
+{
+	for (unsigned int i = 0; i < NOF_FIELDS; i++)
+	{
+		Field *f = &fields[i];
+		f->type = rnd(3);
+		f->value = rnd(2) ? (int64_t)rnd(100) - 50 : (int64_t)rnd(1000000);
+		random_string(f->str, f->type == 2);
+	}
+}
+
+// The model of the encoder.
+typedef struct
+{
+	unsigned char *p;
+	unsigned int n;
+	int state; // 0 nothing written, 1 number, 2 string
+	int64_t prev;
+	uint64_t repeat;
+} Model;
+
+static void model_put(Model *m, unsigned int code, unsigned int nofb, uint64_t data)
+{
+	m->p[m->n++] = code + (data & ((1U << nofb) - 1));
+	data = data >> nofb;
+	while (data > 0)
+	{
+		m->p[m->n++] = DBF_EXT_CODEID + (data & DBF_EXT_DATAMASK);
+		data = data >> DBF_EXT_DATANBITS;
+	}
+}
+
+// A repeat code is written before any other code, after it the code before is 0.
+static void model_flush(Model *m)
+{
+	if (m->repeat > 0)
+	{
+		model_put(m, DBF_REPEAT_CODEID, DBF_REPEAT_DATANBITS, m->repeat);
+		m->repeat = 0;
+		m->prev = 0;
+	}
+}
+
+static void model_code(Model *m, int64_t i)
+{
+	if (i == m->prev)
+	{
+		m->repeat++;
+		return;
+	}
+	model_flush(m);
+	if (i >= 0)
+	{
+		model_put(m, DBF_PINT_CODEID, DBF_PINT_DATANBITS, i);
+	}
+	else
+	{
+		model_put(m, DBF_NINT_CODEID, DBF_NINT_DATANBITS, -1 - i);
+	}
+	m->prev = i;
+}
+
+static void model_format(Model *m, unsigned int code)
+{
+	model_flush(m);
+	model_put(m, DBF_FMTCRC_CODEID, DBF_FMTCRC_DATANBITS, code);
+}
+
+static unsigned int model_message(unsigned char *p)
+{
+	Model m = {p, 0, 0, 0, 0};
+	for (unsigned int i = 0; i < NOF_FIELDS; i++)
+	{
+		const Field *f = &fields[i];
+		if (f->type == 0)
+		{
+			if (m.state == 2)
+			{
+				model_format(&m, DBF_INT_BEGIN_CODE);
+			}
+			m.state = 1;
+			model_code(&m, f->value);
+		}
+		else
+		{
+			// A word that begins with a character that can not be in a word is written as a string.
+			model_format(&m, ((f->type == 2) && (f->str[0] > ' ')) ? DBF_WORD_BEGIN_CODE : DBF_STR_BEGIN_CODE);
+			m.state = 2;
+			for (const char *s = f->str; *s; s++)
+			{
+				model_code(&m, *s - 64);
+			}
+		}
+	}
+	model_flush(&m);
+	return m.n;
+}
+
+static void write_message(DbfSerializer *s)
+{
+	for (unsigned int i = 0; i < NOF_FIELDS; i++)
+	{
+		const Field *f = &fields[i];
+		switch (f->type)
+		{
+			case 0: DbfSerializerWriteInt64(s, f->value); break;
+			case 1: DbfSerializerWriteString(s, f->str); break;
+			default: DbfSerializerWriteWord(s, f->str); break;
+		}
+	}
+}
+
+int main(void)
+{
+	static unsigned char ref[MAX_MSG];
+	static unsigned char buf[MAX_MSG + 32];
+	st_init();
+	for (unsigned int round = 0; (round < 20000) && (failures == 0); round++)
+	{
+		random_message();
+		const unsigned int len = model_message(ref);
+
+		DbfSerializer s;
+		DbfSerializerInit(&s);
+		write_message(&s);
+		DbfSerializerFinalize(&s);
+		CHECK(DbfSerializerGetMsgLen(&s) == len);
+		CHECK(memcmp(DbfSerializerGetMsgPtr(&s), ref, len) == 0);
+		DbfSerializerDeinit(&s);
+
+		// Caller given buffer, sometimes too small. Bytes after it must be left as they were.
+		const unsigned int size = rnd(2) ? rnd(len + 20) : len;
+		memset(buf, 0x5a, sizeof(buf));
+		DbfSerializerInitBuffer(&s, buf, size);
+		write_message(&s);
+		DbfSerializerFinalize(&s);
+		CHECK(DbfSerializerIsOverflow(&s) == (len > size));
+		CHECK(DbfSerializerGetMsgLen(&s) <= size);
+		CHECK(memcmp(buf, ref, DbfSerializerGetMsgLen(&s)) == 0);
+		for (unsigned int i = size; i < sizeof(buf); i++)
+		{
+			CHECK(buf[i] == 0x5a);
+		}
+		DbfSerializerDeinit(&s);
+
+		// With the running CRC, same message and same CRC.
+		DbfSerializer r;
+		DbfSerializerInit(&s);
+		DbfSerializerInit(&r);
+		DbfSerializerEnableRunningCrc(&r);
+		write_message(&s);
+		write_message(&r);
+		DbfSerializerWriteCrc(&s);
+		DbfSerializerWriteCrc(&r);
+		CHECK(DbfSerializerGetMsgLen(&s) == DbfSerializerGetMsgLen(&r));
+		CHECK(memcmp(DbfSerializerGetMsgPtr(&s), DbfSerializerGetMsgPtr(&r), DbfSerializerGetMsgLen(&s)) == 0);
+		CHECK(memcmp(DbfSerializerGetMsgPtr(&s), ref, len) == 0);
+		DbfSerializerDeinit(&s);
+		DbfSerializerDeinit(&r);
+	}
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}
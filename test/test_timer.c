@@ -0,0 +1,298 @@
+/*
+ * test_timer.c
+ *
+ * The timer wheel is compared with a simple model (each timer shall run exactly at
+ * its expire time, or at next ms if that had already passed when it was started),
+ * with random start, stop and advance, also from inside callbacks.
+ * Then a receiver driven by a timer wheel is compared with one that is checked
+ * with DbfReceiverCheckTimeout every ms, given same input at same times.
+ * Build and run from the repository root:
+ * gcc -Isrc src/dbf.c src/crc32.c src/crc32c.c src/sys_time.c src/utility_functions.c \
+ *   src/dbf_timer.c src/dbf_buffer_pool.c test/test_timer.c -lpthread -o test_timer && ./test_timer
+ *
+ *  Created on: Oct 16, 2026
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "dbf.h"
+#include "dbf_timer.h"
+#include "sys_time.h"
+
+static int failures = 0;
+
+#define CHECK(c) {if (!(c)) {printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); failures++;}}
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(uint32_t n)
+{
+	rnd_state ^= rnd_state << 13;
+	rnd_state ^= rnd_state >> 17;
+	rnd_state ^= rnd_state << 5;
+	return rnd_state % n;
+}
+
+#define NOF_TIMERS 100
+
+typedef struct
+{
+	DbfTimer timer;
+	int running; // In the model.
+	uint64_t dueMs; // When the model says it shall run.
+} TestTimer;
+
+static DbfTimerWheel wheel;
+static TestTimer timers[NOF_TIMERS];
+static unsigned int nofRun;
+
+// Delays of all sizes: within level 0, in the higher levels, beyond what the wheel covers and in the past.
+static uint64_t random_expire(uint64_t now)
+{
+	switch (rnd(6))
+	{
+		case 0: return now + rnd(70);
+		case 1: return now + rnd(5000);
+		case 2: return now + rnd(300000);
+		case 3: return now + (1ULL << 24) - 100 + rnd(200);
+		case 4: return now + (1ULL << 24) + rnd(100000);
+		default: return now - rnd((now < 100) ? (uint32_t)now + 1 : 100);
+	}
+}
+
+static void model_start(TestTimer *t, uint64_t expiresMs)
+{
+	DbfTimerStart(&wheel, &t->timer, expiresMs);
+	t->running = 1;
+	t->dueMs = (expiresMs > wheel.nowMs) ? expiresMs : wheel.nowMs + 1;
+}
+
+static void model_stop(TestTimer *t)
+{
+	DbfTimerStop(&wheel, &t->timer);
+	t->running = 0;
+}
+
+static void on_test_timer(DbfTimer *timer)
+{
+	TestTimer *t = (TestTimer*)((char*)timer - offsetof(TestTimer, timer));
+	CHECK(t->running);
+	CHECK(t->dueMs == wheel.nowMs);
+	CHECK(!DbfTimerIsRunning(timer));
+	t->running = 0;
+	nofRun++;
+
+	// Callbacks may start and stop timers, also the one being run.
+	switch (rnd(4))
+	{
+		case 0:
+			model_start(t, random_expire(wheel.nowMs));
+			break;
+		case 1:
+			model_start(&timers[rnd(NOF_TIMERS)], random_expire(wheel.nowMs));
+			break;
+		case 2:
+			model_stop(&timers[rnd(NOF_TIMERS)]);
+			break;
+		default:
+			break;
+	}
+}
+
+static void test_wheel(uint64_t startMs)
+{
+	uint64_t now = startMs;
+	DbfTimerWheelInit(&wheel, now);
+	for (unsigned int i = 0; i < NOF_TIMERS; i++)
+	{
+		DbfTimerInit(&timers[i].timer, on_test_timer);
+		timers[i].running = 0;
+	}
+	for (unsigned int step = 0; (step < 10000) && (failures == 0); step++)
+	{
+		TestTimer *t = &timers[rnd(NOF_TIMERS)];
+		switch (rnd(4))
+		{
+			case 0:
+				model_start(t, random_expire(now));
+				break;
+			case 1:
+				model_stop(t);
+				break;
+			default:
+			{
+				const uint32_t r = rnd(1000);
+				now += (r < 900) ? rnd(100) : (r < 998) ? rnd(100000) : rnd(1 << 25);
+				DbfTimerWheelAdvance(&wheel, now);
+				CHECK(wheel.nowMs == now);
+				break;
+			}
+		}
+		unsigned int nofRunning = 0;
+		for (unsigned int i = 0; i < NOF_TIMERS; i++)
+		{
+			CHECK(timers[i].running == DbfTimerIsRunning(&timers[i].timer));
+			if (timers[i].running)
+			{
+				// All that were due have been run.
+				CHECK(timers[i].dueMs > now);
+				nofRunning++;
+			}
+		}
+		CHECK(nofRunning == wheel.nofTimers);
+	}
+}
+
+typedef struct
+{
+	unsigned char data[1 << 21];
+	unsigned int len;
+	unsigned int nofMsgs;
+} Log;
+
+static void on_message(void *user, DbfReceiver *r)
+{
+	Log *log = user;
+	// Encoding, size and bytes of each message.
+	const unsigned int n = r->msgSize;
+	if (log->len + n + 8 <= sizeof(log->data))
+	{
+		log->data[log->len++] = (unsigned char)DbfReceiverGetEncoding(r);
+		memcpy(log->data + log->len, &n, sizeof(n));
+		log->len += sizeof(n);
+		memcpy(log->data + log->len, DbfReceiverGetMsgPtr(r), n);
+		log->len += n;
+	}
+	log->nofMsgs++;
+}
+
+// Random input with big DBF messages (so memory is allocated and later freed when idle),
+// messages that are never ended, text and noise.
+static unsigned int random_input(unsigned char *p)
+{
+	unsigned int n = 0;
+	switch (rnd(6))
+	{
+		case 0:
+		case 1:
+		{
+			const unsigned int size = rnd(3) ? rnd(200) : 1000 + rnd(3000);
+			p[n++] = DBF_BEGIN_CODEID;
+			for (unsigned int i = 0; i < size; i++)
+			{
+				p[n++] = 2 + rnd(254);
+			}
+			if (rnd(4) != 0)
+			{
+				p[n++] = DBF_END_CODEID;
+			}
+			break;
+		}
+		case 2:
+			for (unsigned int i = rnd(50); i > 0; i--)
+			{
+				p[n++] = ' ' + rnd('~' - ' ' + 1);
+			}
+			p[n++] = '\n';
+			break;
+		case 3:
+			// Noise.
+			for (unsigned int i = 1 + rnd(5); i > 0; i--)
+			{
+				p[n++] = 0x80 + rnd(0x80);
+			}
+			break;
+		default:
+			for (unsigned int i = 1 + rnd(20); i > 0; i--)
+			{
+				p[n++] = rnd(256);
+			}
+			break;
+	}
+	return n;
+}
+
+// Capacity of a receiver that has no allocated memory (that of its inline buffer,
+// or zero with DBF_RCV_NO_INLINE_BUFFER).
+static unsigned int idleCapacity;
+
+static void check_same_receiver(const DbfReceiver *a, const DbfReceiver *b)
+{
+	CHECK(a->receiverState == b->receiverState);
+	CHECK(a->msgSize == b->msgSize);
+	// Same capacity also means both or neither have allocated memory.
+	CHECK(a->capacity == b->capacity);
+	CHECK((a->msgSize == 0) || (memcmp(DbfReceiverGetMsgPtr(a), DbfReceiverGetMsgPtr(b), a->msgSize) == 0));
+}
+
+static void test_receiver_wheel(void)
+{
+	static unsigned char input[8000];
+	static Log logA;
+	static Log logB;
+	DbfClock clock;
+	DbfTimerWheel w;
+	DbfReceiver a;
+	DbfReceiver b;
+	unsigned int nofReleased = 0;
+
+	DbfClockInitTick(&clock, 0);
+	clock.ms = 100000;
+	DbfTimerWheelInit(&w, clock.ms);
+	DbfReceiverInit(&a);
+	DbfReceiverInit(&b);
+	DbfReceiverSetClock(&a, &clock);
+	DbfReceiverSetClock(&b, &clock);
+	DbfReceiverSetMaxMsgSize(&a, 8192);
+	DbfReceiverSetMaxMsgSize(&b, 8192);
+	DbfReceiverSetTimerWheel(&a, &w);
+	idleCapacity = b.capacity;
+	logA.len = logA.nofMsgs = 0;
+	logB.len = logB.nofMsgs = 0;
+
+	for (unsigned int step = 0; (step < 2000) && (failures == 0); step++)
+	{
+		// Time passes, sometimes long enough for noise, DBF and idle timeouts.
+		const uint32_t r = rnd(100);
+		const unsigned int gap = (r < 60) ? rnd(50) : (r < 80) ? rnd(300) : (r < 95) ? rnd(6000) : rnd(12000);
+		for (unsigned int ms = 0; ms < gap; ms++)
+		{
+			clock.ms++;
+			DbfTimerWheelAdvance(&w, clock.ms);
+			const int wasBig = (b.capacity != idleCapacity);
+			// Same timeouts as the receiver uses with a timer wheel.
+			DbfReceiverCheckTimeout(&b, (b.receiverState == DbfRcvIgnoreInputState) ? 100 : DBF_RCV_TIMEOUT_MS);
+			if (wasBig && (b.capacity == idleCapacity))
+			{
+				nofReleased++;
+			}
+			check_same_receiver(&a, &b);
+		}
+		const unsigned int n = random_input(input);
+		DbfReceiverProcessBuffer(&a, input, n, on_message, &logA);
+		DbfReceiverProcessBuffer(&b, input, n, on_message, &logB);
+		check_same_receiver(&a, &b);
+	}
+	CHECK(logA.nofMsgs == logB.nofMsgs);
+	CHECK((logA.len == logB.len) && (memcmp(logA.data, logB.data, logA.len) == 0));
+	// Make sure the test did what it is meant to.
+	CHECK(nofReleased > 0);
+	printf("receiver: %u messages, %u idle releases\n", logA.nofMsgs, nofReleased);
+	DbfReceiverDeinit(&a);
+	DbfReceiverDeinit(&b);
+	CHECK(w.nofTimers == 0);
+}
+
+int main(void)
+{
+	st_init();
+	test_wheel(0);
+	test_wheel(123456789);
+	test_wheel(((uint64_t)1 << 32) - 5000);
+	printf("wheel: %u timers run\n", nofRun);
+	test_receiver_wheel();
+	printf("%s\n", failures ? "FAIL" : "OK");
+	return failures ? 1 : 0;
+}